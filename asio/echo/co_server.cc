@@ -5,6 +5,9 @@
 #include <boost/context/fixedsize_stack.hpp>
 #include <boost/context/pooled_fixedsize_stack.hpp>
 
+#include "unique_ptr.h"
+#include "intrusive_ptr.h"
+
 namespace sys = boost::system;
 namespace asio = boost::asio;
 using asio::ip::tcp;
@@ -22,15 +25,15 @@ handle_spawn (std::exception_ptr e)
     std::rethrow_exception (e);
 }
 
-class session : public std::enable_shared_from_this<session>
+class session : public intrusive_ref_counter<session>
 {
 public:
-  using pointer = std::shared_ptr<session>;
+  using pointer = intrusive_ptr<session>;
 
   static pointer
   make (tcp::socket sock, asio::chrono::seconds timeout = default_timeout)
   {
-    return std::make_shared<session> (std::move (sock), timeout);
+    return make_intrusive<session> (std::move (sock), timeout);
   }
 
   explicit session (tcp::socket sock,
@@ -52,36 +55,35 @@ private:
   void
   start_with_timeout ()
   {
-    auto self = shared_from_this ();
-    auto echo{ [this, self] (asio::yield_context yield) {
+    auto echo{ [this, self = pointer (this)] (asio::yield_context yield) {
       for (;;)
 	{
 	  size_t n;
 	  sys::error_code ec;
 
 	  start_timeout ();
-	  buffer_.resize (max_receive);
-	  n = socket_.async_receive (asio::buffer (buffer_), yield[ec]);
+	  n = socket_.async_receive (
+	      asio::buffer (buffer_.get (), max_receive), yield[ec]);
 	  timer_.cancel ();
 	  if (ec)
 	    break;
 
 	  start_timeout ();
-	  buffer_.resize (n);
-	  asio::async_write (socket_, asio::buffer (buffer_), yield[ec]);
+	  asio::async_write (socket_, asio::buffer (buffer_.get (), n),
+			     yield[ec]);
 	  timer_.cancel ();
 	  if (ec)
 	    break;
 	}
     } };
-    asio::spawn (strand_, std::allocator_arg, allocator, echo, handle_spawn);
+    asio::spawn (strand_, std::allocator_arg, allocator, std::move (echo),
+		 handle_spawn);
   }
 
   void
   start_timeout ()
   {
-    auto self = shared_from_this ();
-    auto wait{ [this, self] (asio::yield_context yield) {
+    auto wait{ [this, self = pointer (this)] (asio::yield_context yield) {
       timer_.expires_after (timeout_);
 
       sys::error_code ec;
@@ -90,22 +92,22 @@ private:
       if (!ec)
 	socket_.close ();
     } };
-    asio::spawn (strand_, std::allocator_arg, allocator, wait, handle_spawn);
+    asio::spawn (strand_, std::allocator_arg, allocator, std::move (wait),
+		 handle_spawn);
   }
 
   void
   start_with_watchdog ()
   {
-    auto self = shared_from_this ();
-    auto echo{ [this, self] (asio::yield_context yield) {
+    auto echo{ [this, self = pointer (this)] (asio::yield_context yield) {
       for (;;)
 	{
 	  size_t n;
 	  sys::error_code ec;
 
 	  deadline_ = asio::chrono::steady_clock::now () + timeout_;
-	  buffer_.resize (max_receive);
-	  n = socket_.async_receive (asio::buffer (buffer_), yield[ec]);
+	  n = socket_.async_receive (
+	      asio::buffer (buffer_.get (), max_receive), yield[ec]);
 	  if (ec)
 	    {
 	      timer_.cancel ();
@@ -113,8 +115,8 @@ private:
 	    }
 
 	  deadline_ = asio::chrono::steady_clock::now () + timeout_;
-	  buffer_.resize (n);
-	  asio::async_write (socket_, asio::buffer (buffer_), yield[ec]);
+	  asio::async_write (socket_, asio::buffer (buffer_.get (), n),
+			     yield[ec]);
 	  if (ec)
 	    {
 	      timer_.cancel ();
@@ -122,7 +124,8 @@ private:
 	    }
 	}
     } };
-    asio::spawn (strand_, std::allocator_arg, allocator, echo, handle_spawn);
+    asio::spawn (strand_, std::allocator_arg, allocator, std::move (echo),
+		 handle_spawn);
 
     start_watchdog ();
   }
@@ -130,8 +133,7 @@ private:
   void
   start_watchdog ()
   {
-    auto self = shared_from_this ();
-    auto watch{ [this, self] (asio::yield_context yield) {
+    auto watch{ [this, self = pointer (this)] (asio::yield_context yield) {
       for (;;)
 	{
 	  auto now = asio::chrono::steady_clock::now ();
@@ -148,7 +150,8 @@ private:
 	    break;
 	}
     } };
-    asio::spawn (strand_, std::allocator_arg, allocator, watch, handle_spawn);
+    asio::spawn (strand_, std::allocator_arg, allocator, std::move (watch),
+		 handle_spawn);
   }
 
 private:
@@ -156,7 +159,8 @@ private:
   asio::steady_timer timer_{ socket_.get_executor () };
   asio::strand<asio::any_io_executor> strand_{ socket_.get_executor () };
 
-  std::vector<char> buffer_;
+  unique_ptr<char[]> buffer_
+      = make_unique_for_overwrite<char[]> (max_receive);
   asio::chrono::seconds timeout_;
   asio::steady_timer::time_point deadline_;
 };
@@ -2,6 +2,8 @@
 
 #include <boost/asio.hpp>
 
+#include "intrusive_ptr.h"
+
 namespace sys = boost::system;
 namespace asio = boost::asio;
 namespace chrono = asio::chrono;
@@ -10,16 +12,16 @@ using asio::ip::tcp;
 constexpr chrono::seconds default_timeout (5);
 constexpr size_t buffer_size = 1024;
 
-class session : public std::enable_shared_from_this<session>
+class session : public intrusive_ref_counter<session>
 {
 public:
-  using pointer = std::shared_ptr<session>;
+  using pointer = intrusive_ptr<session>;
 
   static pointer
   make (tcp::socket sock,
 	chrono::steady_clock::duration timeout = default_timeout)
   {
-    return std::make_shared<session> (std::move (sock), timeout);
+    return make_intrusive<session> (std::move (sock), timeout);
   }
 
   explicit session (tcp::socket sock,
@@ -51,8 +53,8 @@ private:
   void
   receive_with_watchdog ()
   {
-    auto self = shared_from_this ();
-    auto handle_receive{ [self] (const sys::error_code &error, size_t bytes) {
+    auto handle_receive{ [self = pointer (this)] (const sys::error_code &error,
+						  size_t bytes) {
       if (error)
 	{
 	  self->stop ();
@@ -62,7 +64,8 @@ private:
     } };
 
     socket_.async_receive (asio::buffer (buffer_),
-			   asio::bind_executor (strand_, handle_receive));
+			   asio::bind_executor (strand_,
+						std::move (handle_receive)));
 
     deadline_ = chrono::steady_clock::now () + timeout_;
   }
@@ -70,9 +73,8 @@ private:
   void
   send_with_watchdog (size_t bytes_to_send)
   {
-    auto self = shared_from_this ();
-    auto handle_write{ [self] (const sys::error_code &error,
-			       size_t /*bytes*/) {
+    auto handle_write{ [self = pointer (this)] (const sys::error_code &error,
+						size_t /*bytes*/) {
       if (error)
 	{
 	  self->stop ();
@@ -82,7 +84,8 @@ private:
     } };
 
     asio::async_write (socket_, asio::buffer (buffer_, bytes_to_send),
-		       asio::bind_executor (strand_, handle_write));
+		       asio::bind_executor (strand_,
+					    std::move (handle_write)));
 
     deadline_ = chrono::steady_clock::now () + timeout_;
   }
@@ -97,21 +100,20 @@ private:
 	return;
       }
 
-    auto self = shared_from_this ();
-    auto handle_wait{ [self] (const sys::error_code &error) {
+    auto handle_wait{ [self = pointer (this)] (const sys::error_code &error) {
       if (!error)
 	self->start_watchdog ();
     } };
 
     timer_.expires_at (deadline_);
-    timer_.async_wait (asio::bind_executor (strand_, handle_wait));
+    timer_.async_wait (asio::bind_executor (strand_, std::move (handle_wait)));
   }
 
   void
   receive_with_timeout ()
   {
-    auto self = shared_from_this ();
-    auto handle_receive{ [self] (const sys::error_code &error, size_t bytes) {
+    auto handle_receive{ [self = pointer (this)] (const sys::error_code &error,
+						  size_t bytes) {
       self->timer_.cancel ();
       if (error)
 	{
@@ -122,7 +124,8 @@ private:
     } };
 
     socket_.async_receive (asio::buffer (buffer_),
-			   asio::bind_executor (strand_, handle_receive));
+			   asio::bind_executor (strand_,
+						std::move (handle_receive)));
 
     start_timeout ();
   }
@@ -130,9 +133,8 @@ private:
   void
   send_with_timeout (size_t bytes_to_send)
   {
-    auto self = shared_from_this ();
-    auto handle_write{ [self] (const sys::error_code &error,
-			       size_t /*bytes*/) {
+    auto handle_write{ [self = pointer (this)] (const sys::error_code &error,
+						size_t /*bytes*/) {
       self->timer_.cancel ();
       if (error)
 	{
@@ -143,7 +145,8 @@ private:
     } };
 
     asio::async_write (socket_, asio::buffer (buffer_, bytes_to_send),
-		       asio::bind_executor (strand_, handle_write));
+		       asio::bind_executor (strand_,
+					    std::move (handle_write)));
 
     start_timeout ();
   }
@@ -151,14 +154,13 @@ private:
   void
   start_timeout ()
   {
-    auto self = shared_from_this ();
-    auto handle_wait{ [self] (const sys::error_code &error) {
+    auto handle_wait{ [self = pointer (this)] (const sys::error_code &error) {
       if (!error)
 	self->stop ();
     } };
 
     timer_.expires_after (timeout_);
-    timer_.async_wait (asio::bind_executor (strand_, handle_wait));
+    timer_.async_wait (asio::bind_executor (strand_, std::move (handle_wait)));
   }
 
 private:
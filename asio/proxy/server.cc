@@ -1,5 +1,7 @@
 #include <boost/asio.hpp>
 
+#include "intrusive_ptr.h"
+
 namespace sys = boost::system;
 namespace asio = boost::asio;
 using asio::ip::tcp;
@@ -49,16 +51,16 @@ private:
   asio::steady_timer::time_point deadline_;
 };
 
-class session : public std::enable_shared_from_this<session>
+class session : public intrusive_ref_counter<session, thread_unsafe_counter>
 {
 public:
-  using pointer = std::shared_ptr<session>;
+  using pointer = intrusive_ptr<session>;
 
   static pointer
   make (tcp::socket client,
 	asio::chrono::steady_clock::duration timeout = default_timeout)
   {
-    return std::make_shared<session> (std::move (client), timeout);
+    return make_intrusive<session> (std::move (client), timeout);
   }
 
   explicit session (tcp::socket client,
@@ -71,8 +73,8 @@ public:
   void
   start (const tcp::endpoint &target)
   {
-    auto self = shared_from_this ();
-    auto handle_connect{ [self] (const sys::error_code &error) {
+    auto handle_connect{ [self = pointer (this)] (
+			     const sys::error_code &error) {
       if (error)
 	return;
       self->receive_from_client ();
@@ -80,7 +82,7 @@ public:
       self->start_watchdogs ();
     } };
 
-    server_.async_connect (target, handle_connect);
+    server_.async_connect (target, std::move (handle_connect));
   }
 
 private:
@@ -96,8 +98,8 @@ private:
   void
   receive_from_client ()
   {
-    auto self = shared_from_this ();
-    auto handle_receive{ [self] (const sys::error_code &error, size_t bytes) {
+    auto handle_receive{ [self = pointer (this)] (const sys::error_code &error,
+						  size_t bytes) {
       if (error)
 	{
 	  self->stop ();
@@ -107,16 +109,16 @@ private:
     } };
 
     client_.async_receive (asio::buffer (client_buffer_),
-			   asio::bind_executor (strand1_, handle_receive));
+			   asio::bind_executor (strand1_,
+						std::move (handle_receive)));
     watchdog1_.delay (timeout_);
   }
 
   void
   send_to_server (size_t bytes_to_send)
   {
-    auto self = shared_from_this ();
-    auto handle_write{ [self] (const sys::error_code &error,
-			       size_t /*bytes*/) {
+    auto handle_write{ [self = pointer (this)] (const sys::error_code &error,
+						size_t /*bytes*/) {
       if (error)
 	{
 	  self->stop ();
@@ -126,15 +128,16 @@ private:
     } };
 
     asio::async_write (server_, asio::buffer (client_buffer_, bytes_to_send),
-		       asio::bind_executor (strand1_, handle_write));
+		       asio::bind_executor (strand1_,
+					    std::move (handle_write)));
     watchdog1_.delay (timeout_);
   }
 
   void
   receive_from_server ()
   {
-    auto self = shared_from_this ();
-    auto handle_receive{ [self] (const sys::error_code &error, size_t bytes) {
+    auto handle_receive{ [self = pointer (this)] (const sys::error_code &error,
+						  size_t bytes) {
       if (error)
 	{
 	  self->stop ();
@@ -144,16 +147,16 @@ private:
     } };
 
     server_.async_receive (asio::buffer (server_buffer_),
-			   asio::bind_executor (strand2_, handle_receive));
+			   asio::bind_executor (strand2_,
+						std::move (handle_receive)));
     watchdog2_.delay (timeout_);
   }
 
   void
   send_to_client (size_t bytes_to_send)
   {
-    auto self = shared_from_this ();
-    auto handle_write{ [self] (const sys::error_code &error,
-			       size_t /*bytes*/) {
+    auto handle_write{ [self = pointer (this)] (const sys::error_code &error,
+						size_t /*bytes*/) {
       if (error)
 	{
 	  self->stop ();
@@ -163,15 +166,15 @@ private:
     } };
 
     asio::async_write (client_, asio::buffer (server_buffer_, bytes_to_send),
-		       asio::bind_executor (strand2_, handle_write));
+		       asio::bind_executor (strand2_,
+					    std::move (handle_write)));
     watchdog2_.delay (timeout_);
   }
 
   void
   start_watchdogs ()
   {
-    auto self = shared_from_this ();
-    auto callback{ [self] () { self->stop (); } };
+    auto callback{ [self = pointer (this)] () { self->stop (); } };
 
     watchdog1_.start (callback);
     watchdog2_.start (callback);
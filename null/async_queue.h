@@ -0,0 +1,335 @@
+#ifndef ASYNC_QUEUE_H
+#define ASYNC_QUEUE_H
+
+#include <mutex>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <optional>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/associated_executor.hpp>
+
+#include "circular_buffer.h"
+
+template <typename T, typename Executor = boost::asio::any_io_executor,
+	  typename Alloc = std::allocator<T>>
+class async_queue
+{
+  using error_code = boost::system::error_code;
+
+  struct pop_waiter
+  {
+    virtual ~pop_waiter () = default;
+    virtual void complete (error_code ec, std::optional<T> elem) = 0;
+  };
+
+  struct push_waiter
+  {
+    template <typename U>
+    explicit push_waiter (U &&elem_) : elem (std::forward<U> (elem_))
+    {
+    }
+
+    virtual ~push_waiter () = default;
+    virtual void complete (error_code ec) = 0;
+
+    T elem;
+  };
+
+  template <typename Handler>
+  struct pop_op : public pop_waiter
+  {
+    pop_op (Handler handler_, const Executor &ex)
+	: handler (std::move (handler_)),
+	  work (boost::asio::make_work_guard (handler, ex))
+    {
+    }
+
+    void
+    complete (error_code ec, std::optional<T> elem) override
+    {
+      auto ex = work.get_executor ();
+      boost::asio::post (ex, [h = std::move (handler), ec,
+			      elem = std::move (elem)] () mutable {
+	h (ec, std::move (elem));
+      });
+      work.reset ();
+    }
+
+    Handler handler;
+    decltype (boost::asio::make_work_guard (std::declval<Handler &> (),
+					    std::declval<const Executor &> ()))
+	work;
+  };
+
+  template <typename Handler>
+  struct push_op : public push_waiter
+  {
+    template <typename U>
+    push_op (U &&elem_, Handler handler_, const Executor &ex)
+	: push_waiter (std::forward<U> (elem_)),
+	  handler (std::move (handler_)),
+	  work (boost::asio::make_work_guard (handler, ex))
+    {
+    }
+
+    void
+    complete (error_code ec) override
+    {
+      auto ex = work.get_executor ();
+      boost::asio::post (ex, [h = std::move (handler), ec] () mutable {
+	h (ec);
+      });
+      work.reset ();
+    }
+
+    Handler handler;
+    decltype (boost::asio::make_work_guard (std::declval<Handler &> (),
+					    std::declval<const Executor &> ()))
+	work;
+  };
+
+  struct completions
+  {
+    std::vector<std::pair<std::unique_ptr<pop_waiter>, std::optional<T>>>
+	pops;
+    std::vector<std::pair<std::unique_ptr<push_waiter>, error_code>> pushes;
+    error_code pop_error;
+
+    void
+    run ()
+    {
+      for (auto &p : pops)
+	p.first->complete (pop_error, std::move (p.second));
+      for (auto &p : pushes)
+	p.first->complete (p.second);
+    }
+  };
+
+public:
+  using element_type = T;
+  using size_type = size_t;
+  using executor_type = Executor;
+  using allocator_type = Alloc;
+
+  explicit async_queue (const executor_type &ex,
+			size_type capacity
+			= std::numeric_limits<size_type>::max (),
+			const Alloc &alloc = Alloc ())
+      : ex_ (ex), capacity_ (capacity), queue_ (alloc), closed_ (false)
+  {
+    if (capacity_ != std::numeric_limits<size_type>::max ())
+      queue_.reserve (capacity_);
+  }
+
+  async_queue (const async_queue &) = delete;
+  async_queue &operator= (const async_queue &) = delete;
+
+  executor_type
+  get_executor () const noexcept
+  {
+    return ex_;
+  }
+
+  template <typename U, typename CompletionToken>
+  auto
+  async_push (U &&elem, CompletionToken &&token)
+  {
+    return boost::asio::async_initiate<CompletionToken, void (error_code)> (
+	[this] (auto handler, auto &&value) {
+	  start_push (std::forward<decltype (value)> (value),
+		      std::move (handler));
+	},
+	token, std::forward<U> (elem));
+  }
+
+  // completes with an element, or with eof and an empty optional once
+  // the queue is closed and drained
+  template <typename CompletionToken>
+  auto
+  async_pop (CompletionToken &&token)
+  {
+    return boost::asio::async_initiate<CompletionToken,
+				       void (error_code, std::optional<T>)> (
+	[this] (auto handler) { start_pop (std::move (handler)); }, token);
+  }
+
+  template <typename U>
+  bool
+  try_push (U &&elem)
+  {
+    completions done;
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      if (closed_ || (pop_waiters_.empty () && queue_.size () >= capacity_))
+	return false;
+      enqueue (std::forward<U> (elem), done);
+    }
+    done.run ();
+    return true;
+  }
+
+  std::optional<T>
+  try_pop ()
+  {
+    completions done;
+    std::optional<T> elem;
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      if (queue_.empty ())
+	return std::nullopt;
+      elem.emplace (dequeue (done));
+    }
+    done.run ();
+    return elem;
+  }
+
+  void
+  close ()
+  {
+    completions done;
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      closed_ = true;
+
+      done.pop_error = boost::asio::error::eof;
+      while (!pop_waiters_.empty ())
+	{
+	  done.pops.emplace_back (std::move (pop_waiters_.front ()),
+				  std::nullopt);
+	  pop_waiters_.pop_front ();
+	}
+
+      while (!push_waiters_.empty ())
+	{
+	  done.pushes.emplace_back (std::move (push_waiters_.front ()),
+				    boost::asio::error::broken_pipe);
+	  push_waiters_.pop_front ();
+	}
+    }
+    done.run ();
+  }
+
+  size_type
+  size () const
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return queue_.size ();
+  }
+
+  bool
+  empty () const
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return queue_.empty ();
+  }
+
+  bool
+  is_closed () const
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return closed_;
+  }
+
+private:
+  template <typename U, typename Handler>
+  void
+  start_push (U &&elem, Handler handler)
+  {
+    completions done;
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      if (!closed_ && pop_waiters_.empty () && queue_.size () >= capacity_)
+	{
+	  push_waiters_.push_back (std::make_unique<push_op<Handler>> (
+	      std::forward<U> (elem), std::move (handler), ex_));
+	  return;
+	}
+
+      auto op = std::make_unique<push_op<Handler>> (
+	  std::forward<U> (elem), std::move (handler), ex_);
+
+      error_code ec = boost::asio::error::broken_pipe;
+      if (!closed_)
+	{
+	  enqueue (std::move (op->elem), done);
+	  ec = {};
+	}
+      done.pushes.emplace_back (std::move (op), ec);
+    }
+    done.run ();
+  }
+
+  template <typename Handler>
+  void
+  start_pop (Handler handler)
+  {
+    completions done;
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      auto op = std::make_unique<pop_op<Handler>> (std::move (handler), ex_);
+
+      if (!queue_.empty ())
+	done.pops.emplace_back (std::move (op), dequeue (done));
+      else if (closed_)
+	{
+	  done.pop_error = boost::asio::error::eof;
+	  done.pops.emplace_back (std::move (op), std::nullopt);
+	}
+      else
+	pop_waiters_.push_back (std::move (op));
+    }
+    done.run ();
+  }
+
+  // called with mutex_ held; a parked consumer takes the element directly
+  template <typename U>
+  void
+  enqueue (U &&elem, completions &done)
+  {
+    if (!pop_waiters_.empty ())
+      {
+	done.pops.emplace_back (std::move (pop_waiters_.front ()),
+				std::forward<U> (elem));
+	pop_waiters_.pop_front ();
+      }
+    else
+      queue_.push_back (std::forward<U> (elem));
+  }
+
+  // called with mutex_ held; refills the slot from a parked producer
+  T
+  dequeue (completions &done)
+  {
+    T elem = std::move (queue_.front ());
+    queue_.pop_front ();
+
+    if (!push_waiters_.empty ())
+      {
+	auto &op = push_waiters_.front ();
+	queue_.push_back (std::move (op->elem));
+	done.pushes.emplace_back (std::move (op), error_code ());
+	push_waiters_.pop_front ();
+      }
+
+    return elem;
+  }
+
+private:
+  executor_type ex_;
+  size_type capacity_;
+  circular_buffer<T, Alloc> queue_;
+  mutable std::mutex mutex_;
+
+  bool closed_;
+  circular_buffer<std::unique_ptr<pop_waiter>> pop_waiters_;
+  circular_buffer<std::unique_ptr<push_waiter>> push_waiters_;
+};
+
+#endif // ASYNC_QUEUE_H
@@ -0,0 +1,260 @@
+#ifndef ATOMIC_SHARED_PTR_H
+#define ATOMIC_SHARED_PTR_H
+
+#include <new>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+#include "shared_ptr.h"
+
+template <typename T>
+class atomic_shared_ptr
+{
+  static_assert (sizeof (void *) == 8, "pointer packing needs 64-bit");
+
+  struct node
+  {
+    explicit node (shared_ptr<T> value_)
+	: value (std::move (value_)), internal (0)
+    {
+    }
+
+    shared_ptr<T> value;
+    std::atomic<long> internal;
+  };
+
+  // the top 16 bits count readers that are copying out of the node, so
+  // the node address must fit in the low 48; make_node throws bad_alloc
+  // for one that does not (5-level paging, tagged pointers). A reader
+  // that finds the count saturated yields until another one leaves.
+  static constexpr int count_shift = 48;
+  static constexpr std::uint64_t count_one = std::uint64_t (1) << count_shift;
+  static constexpr std::uint64_t ptr_mask = count_one - 1;
+
+public:
+  using value_type = shared_ptr<T>;
+
+  static constexpr bool is_always_lock_free
+      = std::atomic<std::uint64_t>::is_always_lock_free;
+
+  atomic_shared_ptr () noexcept : word_ (0) {}
+
+  atomic_shared_ptr (shared_ptr<T> desired) : word_ (pack (make_node (
+						  std::move (desired))))
+  {
+  }
+
+  ~atomic_shared_ptr ()
+  {
+    release_node (word_.load (std::memory_order_relaxed), 0);
+  }
+
+  atomic_shared_ptr (const atomic_shared_ptr &) = delete;
+  atomic_shared_ptr &operator= (const atomic_shared_ptr &) = delete;
+
+  atomic_shared_ptr &
+  operator= (shared_ptr<T> desired)
+  {
+    store (std::move (desired));
+    return *this;
+  }
+
+  operator shared_ptr<T> () const
+  {
+    return load ();
+  }
+
+  bool
+  is_lock_free () const noexcept
+  {
+    return word_.is_lock_free ();
+  }
+
+  // takes and returns a reader slot with two CASes on the shared word,
+  // then copies the value, so every load writes two cache lines that all
+  // readers share: it never blocks, but readers do contend (see the
+  // atomic table of bench/shared_ptr). Keep loads off per-request paths
+  // that scale with cores; cache the snapshot per thread instead.
+  shared_ptr<T>
+  load (std::memory_order = std::memory_order_seq_cst) const
+  {
+    std::uint64_t w = acquire ();
+    node *n = unpack (w);
+    if (!n)
+      return {};
+
+    shared_ptr<T> value = n->value;
+    release (n);
+    return value;
+  }
+
+  void
+  store (shared_ptr<T> desired, std::memory_order = std::memory_order_seq_cst)
+  {
+    std::uint64_t w = pack (make_node (std::move (desired)));
+    release_node (word_.exchange (w, std::memory_order_acq_rel), 0);
+  }
+
+  shared_ptr<T>
+  exchange (shared_ptr<T> desired,
+	    std::memory_order = std::memory_order_seq_cst)
+  {
+    std::uint64_t w = pack (make_node (std::move (desired)));
+    std::uint64_t old = word_.exchange (w, std::memory_order_acq_rel);
+
+    node *n = unpack (old);
+    if (!n)
+      return {};
+
+    // late readers may still be copying n->value, so it is copied too
+    shared_ptr<T> value = n->value;
+    release_node (old, 0);
+    return value;
+  }
+
+  // expected matches when it holds the same pointer and shares ownership
+  // with the stored value. As everywhere in this class the memory order
+  // is ignored: loads acquire and updates are acq_rel.
+  bool
+  compare_exchange_strong (shared_ptr<T> &expected, shared_ptr<T> desired,
+			   std::memory_order = std::memory_order_seq_cst)
+  {
+    node *fresh = make_node (std::move (desired));
+
+    for (;;)
+      {
+	std::uint64_t w = acquire ();
+	node *n = unpack (w);
+
+	if (!equivalent (n, expected))
+	  {
+	    expected = n ? n->value : shared_ptr<T> ();
+	    release (n);
+	    delete fresh;
+	    return false;
+	  }
+
+	// our own reference is part of the count handed over on success
+	while (unpack (w) == n)
+	  if (word_.compare_exchange_weak (w, pack (fresh),
+					   std::memory_order_acq_rel,
+					   std::memory_order_acquire))
+	    {
+	      release_node (w, 1);
+	      return true;
+	    }
+
+	release (n);
+      }
+  }
+
+  bool
+  compare_exchange_weak (shared_ptr<T> &expected, shared_ptr<T> desired,
+			 std::memory_order order = std::memory_order_seq_cst)
+  {
+    return compare_exchange_strong (expected, std::move (desired), order);
+  }
+
+private:
+  static bool
+  equivalent (const node *n, const shared_ptr<T> &expected) noexcept
+  {
+    if (!n)
+      return !expected;
+    return n->value.get () == expected.get ()
+	   && !n->value.owner_before (expected)
+	   && !expected.owner_before (n->value);
+  }
+
+  static node *
+  make_node (shared_ptr<T> value)
+  {
+    if (!value)
+      return nullptr;
+
+    node *n = new node (std::move (value));
+    if (pack (n) & ~ptr_mask)
+      {
+	delete n;
+	throw std::bad_alloc ();
+      }
+    return n;
+  }
+
+  static std::uint64_t
+  pack (node *n) noexcept
+  {
+    return reinterpret_cast<std::uint64_t> (n);
+  }
+
+  static node *
+  unpack (std::uint64_t w) noexcept
+  {
+    return reinterpret_cast<node *> (w & ptr_mask);
+  }
+
+  // bumps the external count so the node stays alive while it is read
+  std::uint64_t
+  acquire () const
+  {
+    std::uint64_t w = word_.load (std::memory_order_acquire);
+    for (;;)
+      {
+	if (!unpack (w))
+	  return w;
+
+	if ((w & ~ptr_mask) == ~ptr_mask)
+	  {
+	    std::this_thread::yield ();
+	    w = word_.load (std::memory_order_acquire);
+	    continue;
+	  }
+
+	if (word_.compare_exchange_weak (w, w + count_one,
+					 std::memory_order_acquire,
+					 std::memory_order_acquire))
+	  return w + count_one;
+      }
+  }
+
+  // drops a reference taken by acquire (); if the node was replaced in
+  // the meantime the external count has already been moved to internal
+  void
+  release (node *n) const
+  {
+    if (!n)
+      return;
+
+    std::uint64_t w = word_.load (std::memory_order_relaxed);
+    while (unpack (w) == n)
+      if (word_.compare_exchange_weak (w, w - count_one,
+				       std::memory_order_release,
+				       std::memory_order_relaxed))
+	return;
+
+    if (n->internal.fetch_sub (1, std::memory_order_acq_rel) == 1)
+      delete n;
+  }
+
+  // called once a word has been swapped out; owned is the number of
+  // references in its count that belong to the caller
+  static void
+  release_node (std::uint64_t w, long owned)
+  {
+    node *n = unpack (w);
+    if (!n)
+      return;
+
+    long external = static_cast<long> (w >> count_shift) - owned;
+    if (n->internal.fetch_add (external, std::memory_order_acq_rel)
+	    + external
+	== 0)
+      delete n;
+  }
+
+private:
+  mutable std::atomic<std::uint64_t> word_;
+};
+
+#endif // ATOMIC_SHARED_PTR_H
@@ -0,0 +1,621 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mpmc_ring_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "concurrent_blocking_queue.h"
+
+using steady_clock = std::chrono::steady_clock;
+constexpr size_t queue_capacity = 1024;
+
+template <size_t Size>
+struct payload
+{
+  unsigned char data[Size];
+};
+
+struct options
+{
+  std::string mode = "latency";
+  std::vector<std::string> queues{ "spsc", "mpmc", "blocking",
+				   "blocking-mpmc" };
+  std::vector<size_t> sizes{ 8 };
+  std::vector<size_t> batches{ 1 };
+  std::vector<size_t> producers{ 1 };
+  std::vector<size_t> consumers{ 1 };
+  long iterations = 100000;
+  std::string placement = "none";
+  std::vector<int> cpus;
+};
+
+inline void
+relax (unsigned &spins)
+{
+  if (++spins < 64)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause ();
+#endif
+      return;
+    }
+  spins = 0;
+  std::this_thread::yield ();
+}
+
+template <typename Q>
+struct queue_ops;
+
+template <typename T>
+struct queue_ops<spsc_ring_buffer<T, queue_capacity>>
+{
+  using queue_type = spsc_ring_buffer<T, queue_capacity>;
+  static constexpr bool multi = false;
+
+  static std::unique_ptr<queue_type>
+  make ()
+  {
+    return std::make_unique<queue_type> ();
+  }
+
+  static void
+  push (queue_type &q, const T &v)
+  {
+    for (unsigned spins = 0; !q.push (v);)
+      relax (spins);
+  }
+
+  static T
+  pop (queue_type &q)
+  {
+    T v;
+    for (unsigned spins = 0; !q.pop (v);)
+      relax (spins);
+    return v;
+  }
+};
+
+template <typename T>
+struct queue_ops<mpmc_ring_buffer<T, queue_capacity>>
+{
+  using queue_type = mpmc_ring_buffer<T, queue_capacity>;
+  static constexpr bool multi = true;
+
+  static std::unique_ptr<queue_type>
+  make ()
+  {
+    return std::make_unique<queue_type> ();
+  }
+
+  static void
+  push (queue_type &q, const T &v)
+  {
+    for (unsigned spins = 0; !q.try_push (v);)
+      relax (spins);
+  }
+
+  static T
+  pop (queue_type &q)
+  {
+    T v;
+    for (unsigned spins = 0; !q.try_pop (v);)
+      relax (spins);
+    return v;
+  }
+};
+
+template <typename T>
+struct queue_ops<concurrent_blocking_queue<T>>
+{
+  using queue_type = concurrent_blocking_queue<T>;
+  static constexpr bool multi = true;
+
+  static std::unique_ptr<queue_type>
+  make ()
+  {
+    return std::make_unique<queue_type> (queue_capacity);
+  }
+
+  static void
+  push (queue_type &q, const T &v)
+  {
+    q.push (v);
+  }
+
+  static T
+  pop (queue_type &q)
+  {
+    return *q.pop ();
+  }
+};
+
+template <typename T>
+struct queue_ops<blocking_mpmc_queue<T, queue_capacity>>
+{
+  using queue_type = blocking_mpmc_queue<T, queue_capacity>;
+  static constexpr bool multi = true;
+
+  static std::unique_ptr<queue_type>
+  make ()
+  {
+    return std::make_unique<queue_type> ();
+  }
+
+  static void
+  push (queue_type &q, const T &v)
+  {
+    q.push (v);
+  }
+
+  static T
+  pop (queue_type &q)
+  {
+    return *q.pop ();
+  }
+};
+
+// parses a list such as 0,2,4-7; empty when any item is malformed
+std::vector<int>
+parse_cpu_list (const std::string &list)
+{
+  std::vector<int> cpus;
+  size_t pos = 0;
+
+  auto number = [] (const std::string &s, int &out) {
+    char *end;
+    long v = std::strtol (s.c_str (), &end, 10);
+    if (s.empty () || *end != '\0' || v < 0 || v >= CPU_SETSIZE)
+      return false;
+    out = static_cast<int> (v);
+    return true;
+  };
+
+  while (pos < list.size ())
+    {
+      size_t end = list.find (',', pos);
+      if (end == std::string::npos)
+	end = list.size ();
+
+      std::string item = list.substr (pos, end - pos);
+      size_t dash = item.find ('-');
+      int first, last;
+
+      if (dash == std::string::npos)
+	{
+	  if (!number (item, first))
+	    return {};
+	  last = first;
+	}
+      else if (!number (item.substr (0, dash), first)
+	       || !number (item.substr (dash + 1), last) || first > last)
+	return {};
+
+      for (int c = first; c <= last; c++)
+	cpus.push_back (c);
+      pos = end + 1;
+    }
+
+  return cpus;
+}
+
+template <typename N>
+std::vector<N>
+parse_numbers (const char *arg)
+{
+  std::vector<N> values;
+  for (int v : parse_cpu_list (arg))
+    values.push_back (static_cast<N> (v));
+  return values;
+}
+
+std::string
+read_topology (int cpu, const char *file)
+{
+  std::string path = "/sys/devices/system/cpu/cpu" + std::to_string (cpu)
+		     + "/topology/" + file;
+  std::ifstream in (path);
+  std::string value;
+  std::getline (in, value);
+  return value;
+}
+
+std::vector<int>
+allowed_cpus ()
+{
+  cpu_set_t set;
+  std::vector<int> cpus;
+
+  CPU_ZERO (&set);
+  if (sched_getaffinity (0, sizeof (set), &set) == 0)
+    for (int c = 0; c < CPU_SETSIZE; c++)
+      if (CPU_ISSET (c, &set))
+	cpus.push_back (c);
+
+  return cpus;
+}
+
+// fills cpus for a placement name or cpu list; false when the name is
+// unknown, a cpu id is bad, or the topology lacks the requested pair
+bool
+resolve_placement (const std::string &name, std::vector<int> &out)
+{
+  auto cpus = allowed_cpus ();
+  auto allowed = [&cpus] (int c) {
+    return std::find (cpus.begin (), cpus.end (), c) != cpus.end ();
+  };
+
+  out.clear ();
+  if (name == "none")
+    return true;
+
+  if (name == "same")
+    {
+      out = { cpus.front () };
+      return true;
+    }
+
+  if (name != "smt" && name != "core" && name != "cross-socket")
+    {
+      auto list = parse_cpu_list (name);
+      if (list.empty ())
+	{
+	  std::fprintf (stderr, "unknown placement '%s'\n", name.c_str ());
+	  return false;
+	}
+      for (int c : list)
+	if (!allowed (c))
+	  {
+	    std::fprintf (stderr, "cpu %d is not available\n", c);
+	    return false;
+	  }
+      out = list;
+      return true;
+    }
+
+  for (int a : cpus)
+    {
+      auto package = read_topology (a, "physical_package_id");
+      auto core = read_topology (a, "core_id");
+
+      if (name == "smt")
+	{
+	  auto siblings = read_topology (a, "thread_siblings_list");
+	  for (int b : parse_cpu_list (siblings))
+	    if (b != a && allowed (b))
+	      {
+		out = { a, b };
+		return true;
+	      }
+	  continue;
+	}
+
+      for (int b : cpus)
+	{
+	  if (b == a)
+	    continue;
+	  bool same_package = read_topology (b, "physical_package_id")
+			      == package;
+	  bool same_core
+	      = same_package && read_topology (b, "core_id") == core;
+
+	  if ((name == "core" && same_package && !same_core)
+	      || (name == "cross-socket" && !same_package))
+	    {
+	      out = { a, b };
+	      return true;
+	    }
+	}
+    }
+
+  std::fprintf (stderr, "placement '%s' is not available on this machine\n",
+		name.c_str ());
+  return false;
+}
+
+void
+pin (const std::vector<int> &cpus, size_t index)
+{
+  if (cpus.empty ())
+    return;
+
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  CPU_SET (cpus[index % cpus.size ()], &set);
+  pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+}
+
+void
+wait_for (const std::atomic<bool> &flag)
+{
+  for (unsigned spins = 0; !flag.load (std::memory_order_acquire);)
+    relax (spins);
+}
+
+void
+report_latency (const char *queue, size_t size, size_t batch,
+		std::vector<double> &samples)
+{
+  std::sort (samples.begin (), samples.end ());
+  auto pct = [&samples] (double p) {
+    auto i = static_cast<size_t> (p * samples.size ());
+    return samples[std::min (i, samples.size () - 1)];
+  };
+
+  std::printf ("%-14s size=%-5zu batch=%-4zu "
+	       "p50=%9.0f p99=%9.0f p99.9=%9.0f max=%9.0f ns\n",
+	       queue, size, batch, pct (0.50), pct (0.99), pct (0.999),
+	       samples.back ());
+}
+
+template <typename Q>
+void
+run_latency (const char *name, size_t size, size_t batch,
+	     const options &opt)
+{
+  using ops = queue_ops<Q>;
+
+  if (batch > queue_capacity)
+    {
+      std::printf ("%-14s size=%-5zu batch=%-4zu skipped (batch > %zu)\n",
+		   name, size, batch, queue_capacity);
+      return;
+    }
+
+  auto ping = ops::make ();
+  auto pong = ops::make ();
+  long warmup = opt.iterations / 10;
+  long rounds = warmup + opt.iterations;
+
+  std::vector<double> samples;
+  samples.reserve (opt.iterations);
+
+  std::thread echo ([&] {
+    pin (opt.cpus, 1);
+    for (long i = 0; i < rounds * static_cast<long> (batch); i++)
+      ops::push (*pong, ops::pop (*ping));
+  });
+
+  std::thread pinger ([&] {
+    pin (opt.cpus, 0);
+    decltype (ops::pop (*pong)) msg{};
+
+    for (long r = 0; r < rounds; r++)
+      {
+	auto start = steady_clock::now ();
+	for (size_t b = 0; b < batch; b++)
+	  ops::push (*ping, msg);
+	for (size_t b = 0; b < batch; b++)
+	  msg = ops::pop (*pong);
+	auto end = steady_clock::now ();
+
+	if (r >= warmup)
+	  samples.push_back (
+	      std::chrono::duration<double, std::nano> (end - start)
+		  .count ());
+      }
+  });
+
+  pinger.join ();
+  echo.join ();
+
+  report_latency (name, size, batch, samples);
+}
+
+template <typename Q>
+void
+run_throughput (const char *name, size_t size, size_t producers,
+		size_t consumers, const options &opt)
+{
+  using ops = queue_ops<Q>;
+  using value_type = decltype (ops::pop (std::declval<Q &> ()));
+
+  if (!ops::multi && (producers != 1 || consumers != 1))
+    return;
+
+  auto q = ops::make ();
+  std::atomic<size_t> ready (0);
+  std::atomic<bool> go (false);
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < producers; i++)
+    threads.emplace_back ([&, i] {
+      pin (opt.cpus, i);
+      value_type msg{};
+      ready++;
+      wait_for (go);
+      for (long n = 0; n < opt.iterations; n++)
+	ops::push (*q, msg);
+    });
+
+  for (size_t i = 0; i < consumers; i++)
+    threads.emplace_back ([&, i] {
+      pin (opt.cpus, producers + i);
+      ready++;
+      wait_for (go);
+      for (;;)
+	if (ops::pop (*q).data[0])
+	  break;
+    });
+
+  for (unsigned spins = 0; ready.load () != producers + consumers;)
+    relax (spins);
+
+  auto start = steady_clock::now ();
+  go.store (true, std::memory_order_release);
+
+  for (size_t i = 0; i < producers; i++)
+    threads[i].join ();
+
+  value_type stop{};
+  stop.data[0] = 1;
+  for (size_t i = 0; i < consumers; i++)
+    ops::push (*q, stop);
+
+  for (size_t i = producers; i < threads.size (); i++)
+    threads[i].join ();
+  auto end = steady_clock::now ();
+
+  double seconds = std::chrono::duration<double> (end - start).count ();
+  double items = static_cast<double> (producers) * opt.iterations;
+
+  std::printf ("%-14s size=%-5zu P=%-2zu C=%-2zu "
+	       "%9.3f Mops/s %10.1f MB/s\n",
+	       name, size, producers, consumers, items / seconds / 1e6,
+	       items * size / seconds / 1e6);
+}
+
+template <typename Q>
+void
+run (const char *name, size_t size, const options &opt)
+{
+  if (opt.mode == "latency")
+    for (size_t batch : opt.batches)
+      run_latency<Q> (name, size, batch, opt);
+  else
+    for (size_t p : opt.producers)
+      for (size_t c : opt.consumers)
+	run_throughput<Q> (name, size, p, c, opt);
+}
+
+template <size_t Size>
+void
+run_size (const options &opt)
+{
+  using T = payload<Size>;
+
+  for (const auto &q : opt.queues)
+    if (q == "spsc")
+      run<spsc_ring_buffer<T, queue_capacity>> ("spsc", Size, opt);
+    else if (q == "mpmc")
+      run<mpmc_ring_buffer<T, queue_capacity>> ("mpmc", Size, opt);
+    else if (q == "blocking")
+      run<concurrent_blocking_queue<T>> ("blocking", Size, opt);
+    else if (q == "blocking-mpmc")
+      run<blocking_mpmc_queue<T, queue_capacity>> ("blocking-mpmc", Size,
+						   opt);
+    else
+      std::fprintf (stderr, "unknown queue '%s'\n", q.c_str ());
+}
+
+void
+usage (const char *prog)
+{
+  std::printf (
+      "Usage: %s [options]\n"
+      "  -m latency|throughput    benchmark mode (default latency)\n"
+      "  -q spsc,mpmc,...         queues: spsc mpmc blocking blocking-mpmc\n"
+      "  -s 8,64,...              element sizes: 8 64 256 1024 4096\n"
+      "  -b 1,16,...              ping-pong burst sizes (latency mode\n"
+      "                           only)\n"
+      "  -p 1,4,...               producer counts (throughput mode)\n"
+      "  -c 1,4,...               consumer counts (throughput mode)\n"
+      "  -n iterations            round trips or items per producer\n"
+      "  -a placement             none same smt core cross-socket or a\n"
+      "                           cpu list such as 0,2,4-7\n",
+      prog);
+}
+
+int
+main (int argc, char **argv)
+{
+  options opt;
+  bool batches_set = false;
+  int ch;
+
+  while ((ch = getopt (argc, argv, "m:q:s:b:p:c:n:a:h")) != -1)
+    switch (ch)
+      {
+      case 'm':
+	opt.mode = optarg;
+	break;
+      case 'q':
+	{
+	  opt.queues.clear ();
+	  std::string list = optarg;
+	  for (size_t pos = 0, end; pos < list.size (); pos = end + 1)
+	    {
+	      end = list.find (',', pos);
+	      if (end == std::string::npos)
+		end = list.size ();
+	      opt.queues.push_back (list.substr (pos, end - pos));
+	    }
+	}
+	break;
+      case 's':
+	opt.sizes = parse_numbers<size_t> (optarg);
+	break;
+      case 'b':
+	opt.batches = parse_numbers<size_t> (optarg);
+	batches_set = true;
+	break;
+      case 'p':
+	opt.producers = parse_numbers<size_t> (optarg);
+	break;
+      case 'c':
+	opt.consumers = parse_numbers<size_t> (optarg);
+	break;
+      case 'n':
+	opt.iterations = std::atol (optarg);
+	break;
+      case 'a':
+	opt.placement = optarg;
+	break;
+      default:
+	usage (argv[0]);
+	return ch == 'h' ? 0 : 1;
+      }
+
+  if (opt.mode == "throughput" && batches_set)
+    std::fprintf (stderr, "-b applies to latency mode only\n");
+
+  if ((opt.mode != "latency" && opt.mode != "throughput")
+      || (opt.mode == "throughput" && batches_set) || opt.sizes.empty ()
+      || opt.batches.empty () || opt.producers.empty ()
+      || opt.consumers.empty ()
+      || !resolve_placement (opt.placement, opt.cpus))
+    {
+      usage (argv[0]);
+      return 1;
+    }
+
+  std::printf ("mode: %s | placement: %s", opt.mode.c_str (),
+	       opt.placement.c_str ());
+  for (size_t i = 0; i < opt.cpus.size (); i++)
+    std::printf ("%s%d", i ? "," : " (cpus ", opt.cpus[i]);
+  std::puts (opt.cpus.empty () ? "" : ")");
+
+  for (size_t size : opt.sizes)
+    switch (size)
+      {
+      case 8:
+	run_size<8> (opt);
+	break;
+      case 64:
+	run_size<64> (opt);
+	break;
+      case 256:
+	run_size<256> (opt);
+	break;
+      case 1024:
+	run_size<1024> (opt);
+	break;
+      case 4096:
+	run_size<4096> (opt);
+	break;
+      default:
+	std::fprintf (stderr, "unsupported element size %zu\n", size);
+	return 1;
+      }
+}
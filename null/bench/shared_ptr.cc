@@ -0,0 +1,388 @@
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include "weak_ptr.h"
+#include "local_shared_ptr.h"
+#include "atomic_shared_ptr.h"
+
+using steady_clock = std::chrono::steady_clock;
+constexpr size_t slots = 64;
+constexpr size_t memory_objects = 100000;
+
+struct object
+{
+  long value[4];
+};
+
+struct options
+{
+  std::vector<std::string> pointers{ "std", "shared", "atomic", "compact",
+				     "local" };
+  std::vector<size_t> threads{ 1, 2, 4 };
+  long iterations = 10000000;
+};
+
+inline void
+clobber (void *p)
+{
+  asm volatile ("" : : "g"(p) : "memory");
+}
+
+template <typename P>
+struct ptr_ops;
+
+template <>
+struct ptr_ops<std::shared_ptr<object>>
+{
+  using weak_type = std::weak_ptr<object>;
+
+  static std::shared_ptr<object>
+  make ()
+  {
+    return std::make_shared<object> ();
+  }
+
+  static std::shared_ptr<object>
+  adopt ()
+  {
+    return std::shared_ptr<object> (new object ());
+  }
+};
+
+template <typename Policy>
+struct ptr_ops<shared_ptr<object, Policy>>
+{
+  using weak_type = weak_ptr<object, Policy>;
+
+  static shared_ptr<object, Policy>
+  make ()
+  {
+    return make_shared<object, Policy> ();
+  }
+
+  static shared_ptr<object, Policy>
+  adopt ()
+  {
+    return shared_ptr<object, Policy> (new object ());
+  }
+};
+
+using atomic_ptr = shared_ptr<object, atomic_refcount<>>;
+using compact_ptr = shared_ptr<object, atomic_refcount<std::int32_t>>;
+
+double
+elapsed_ns (steady_clock::time_point start, long n)
+{
+  std::chrono::duration<double, std::nano> d = steady_clock::now () - start;
+  return d.count () / static_cast<double> (n);
+}
+
+template <typename P>
+double
+run_copy (long n)
+{
+  using ops = ptr_ops<P>;
+  P src = ops::make ();
+
+  auto start = steady_clock::now ();
+  for (long i = 0; i < n; i++)
+    {
+      P p (src);
+      clobber (&p);
+    }
+  return elapsed_ns (start, n);
+}
+
+template <typename P>
+double
+run_weak_lock (long n)
+{
+  using ops = ptr_ops<P>;
+  P src = ops::make ();
+  typename ops::weak_type weak (src);
+
+  auto start = steady_clock::now ();
+  for (long i = 0; i < n; i++)
+    {
+      P p = weak.lock ();
+      clobber (&p);
+    }
+  return elapsed_ns (start, n);
+}
+
+template <typename P, bool Inplace>
+double
+run_create (long n)
+{
+  using ops = ptr_ops<P>;
+  std::vector<P> v (slots);
+
+  auto start = steady_clock::now ();
+  for (long i = 0; i < n; i++)
+    {
+      v[static_cast<size_t> (i) % slots] = Inplace ? ops::make ()
+						    : ops::adopt ();
+      clobber (&v[0]);
+    }
+  return elapsed_ns (start, n);
+}
+
+// heap bytes per live object, allocator overhead included
+template <typename P, bool Inplace>
+double
+run_memory ()
+{
+  using ops = ptr_ops<P>;
+  std::vector<P> v;
+  v.reserve (memory_objects);
+
+  size_t before = mallinfo2 ().uordblks;
+  for (size_t i = 0; i < memory_objects; i++)
+    v.push_back (Inplace ? ops::make () : ops::adopt ());
+  size_t after = mallinfo2 ().uordblks;
+
+  return static_cast<double> (after - before)
+	 / static_cast<double> (memory_objects);
+}
+
+// runs op n times on each thread at once; reports ns per op per thread
+template <typename F>
+double
+run_parallel (size_t threads, long n, F op)
+{
+  std::atomic<size_t> ready (0);
+  std::atomic<bool> go (false);
+  std::vector<double> results (threads);
+  std::vector<std::thread> workers;
+
+  for (size_t t = 0; t < threads; t++)
+    workers.emplace_back ([&, t] {
+      ready.fetch_add (1);
+      while (!go.load (std::memory_order_acquire))
+	;
+
+      auto start = steady_clock::now ();
+      for (long i = 0; i < n; i++)
+	op ();
+      results[t] = elapsed_ns (start, n);
+    });
+
+  while (ready.load () != threads)
+    ;
+  go.store (true, std::memory_order_release);
+
+  for (auto &w : workers)
+    w.join ();
+
+  double sum = 0;
+  for (double r : results)
+    sum += r;
+  return sum / static_cast<double> (threads);
+}
+
+// every thread hammers the same object
+template <typename P, typename F>
+double
+run_contended (size_t threads, long n, F op)
+{
+  using ops = ptr_ops<P>;
+  P src = ops::make ();
+  typename ops::weak_type weak (src);
+
+  return run_parallel (threads, n, [&] { op (src, weak); });
+}
+
+// every thread loads the current snapshot, from an atomic_shared_ptr or
+// from a shared_ptr behind a mutex
+void
+run_snapshot (const options &opt)
+{
+  for (size_t threads : opt.threads)
+    {
+      long n = opt.iterations / static_cast<long> (threads * 4);
+      if (n == 0)
+	n = 1;
+
+      atomic_shared_ptr<object> atomic (make_shared<object> ());
+      double lock_free = run_parallel (threads, n, [&] {
+	shared_ptr<object> p = atomic.load ();
+	clobber (&p);
+      });
+
+      std::mutex mutex;
+      shared_ptr<object> guarded = make_shared<object> ();
+      double locked = run_parallel (threads, n, [&] {
+	shared_ptr<object> p;
+	{
+	  std::lock_guard<std::mutex> lock (mutex);
+	  p = guarded;
+	}
+	clobber (&p);
+      });
+
+      std::printf ("%-8s %8zu %8.2f\n", "atomic", threads, lock_free);
+      std::printf ("%-8s %8zu %8.2f\n", "mutex", threads, locked);
+    }
+}
+
+template <typename P>
+void
+run (const char *name, const options &opt)
+{
+  long n = opt.iterations;
+  long m = n / 10 ? n / 10 : 1;
+
+  std::printf ("%-8s %8.2f %8.2f %8.2f %8.2f %8.1f %8.1f\n", name,
+	       run_copy<P> (n), run_weak_lock<P> (n), run_create<P, true> (m),
+	       run_create<P, false> (m), run_memory<P, true> (),
+	       run_memory<P, false> ());
+}
+
+template <typename P>
+void
+run_threads (const char *name, const options &opt)
+{
+  using weak_type = typename ptr_ops<P>::weak_type;
+
+  for (size_t threads : opt.threads)
+    {
+      long n = opt.iterations / static_cast<long> (threads * 4);
+      if (n == 0)
+	n = 1;
+
+      double copy = run_contended<P> (
+	  threads, n, [] (const P &src, weak_type &) {
+	    P p (src);
+	    clobber (&p);
+	  });
+      double lock = run_contended<P> (
+	  threads, n, [] (const P &, weak_type &weak) {
+	    P p = weak.lock ();
+	    clobber (&p);
+	  });
+
+      std::printf ("%-8s %8zu %8.2f %8.2f\n", name, threads, copy, lock);
+    }
+}
+
+std::vector<std::string>
+split (const char *arg)
+{
+  std::vector<std::string> out;
+  std::string s (arg);
+  for (size_t pos = 0; pos <= s.size ();)
+    {
+      size_t end = s.find (',', pos);
+      if (end == std::string::npos)
+	end = s.size ();
+      out.push_back (s.substr (pos, end - pos));
+      pos = end + 1;
+    }
+  return out;
+}
+
+std::vector<size_t>
+parse_numbers (const char *arg)
+{
+  std::vector<size_t> out;
+  for (auto &s : split (arg))
+    out.push_back (std::strtoul (s.c_str (), nullptr, 10));
+  return out;
+}
+
+void
+usage (const char *prog)
+{
+  std::fprintf (stderr,
+		"usage: %s [-t std,shared,atomic,compact,local] "
+		"[-j 1,2,4] [-n iterations]\n"
+		"  shared counts biased, atomic counts every reference\n"
+		"  atomically, compact is atomic with 32-bit counts\n"
+		"  single thread, ns/op: copy, weak lock, make, adopt\n"
+		"  heap bytes per object: make, adopt\n"
+		"  (copy is copy-construct plus destroy)\n"
+		"  contended, ns/op per thread: copy, weak lock of one\n"
+		"  object shared by -j threads\n"
+		"  snapshot, ns/op per thread: load from one\n"
+		"  atomic_shared_ptr or mutex-guarded shared_ptr\n",
+		prog);
+}
+
+int
+main (int argc, char **argv)
+{
+  options opt;
+  int ch;
+
+  while ((ch = getopt (argc, argv, "t:j:n:h")) != -1)
+    switch (ch)
+      {
+      case 't':
+	opt.pointers = split (optarg);
+	break;
+      case 'j':
+	opt.threads = parse_numbers (optarg);
+	break;
+      case 'n':
+	opt.iterations = std::atol (optarg);
+	break;
+      default:
+	usage (argv[0]);
+	return ch == 'h' ? 0 : 1;
+      }
+
+  if (opt.iterations <= 0)
+    {
+      usage (argv[0]);
+      return 1;
+    }
+
+  for (auto &name : opt.pointers)
+    if (name != "std" && name != "shared" && name != "atomic"
+	&& name != "compact" && name != "local")
+      {
+	std::fprintf (stderr, "unknown pointer type: %s\n", name.c_str ());
+	return 1;
+      }
+
+  std::printf ("%-8s %8s %8s %8s %8s %8s %8s\n", "pointer", "copy", "lock",
+	       "make", "adopt", "B/make", "B/adopt");
+  for (auto &name : opt.pointers)
+    if (name == "std")
+      run<std::shared_ptr<object>> ("std", opt);
+    else if (name == "shared")
+      run<shared_ptr<object>> ("shared", opt);
+    else if (name == "atomic")
+      run<atomic_ptr> ("atomic", opt);
+    else if (name == "compact")
+      run<compact_ptr> ("compact", opt);
+    else
+      run<local_shared_ptr<object>> ("local", opt);
+
+  std::printf ("\n%-8s %8s %8s %8s\n", "pointer", "threads", "copy", "lock");
+  for (auto &name : opt.pointers)
+    if (name == "std")
+      run_threads<std::shared_ptr<object>> ("std", opt);
+    else if (name == "shared")
+      run_threads<shared_ptr<object>> ("shared", opt);
+    else if (name == "atomic")
+      run_threads<atomic_ptr> ("atomic", opt);
+    else if (name == "compact")
+      run_threads<compact_ptr> ("compact", opt);
+
+  std::printf ("\n%-8s %8s %8s\n", "snapshot", "threads", "load");
+  run_snapshot (opt);
+
+  return 0;
+}
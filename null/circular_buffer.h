@@ -0,0 +1,179 @@
+#ifndef CIRCULAR_BUFFER_H
+#define CIRCULAR_BUFFER_H
+
+#include <new>
+#include <memory>
+#include <utility>
+#include <memory_resource>
+
+template <typename T, typename Alloc = std::allocator<T>>
+class circular_buffer
+{
+  using alloc_type =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using allocator_type = alloc_type;
+
+  circular_buffer () noexcept (noexcept (alloc_type ()))
+      : circular_buffer (alloc_type ())
+  {
+  }
+
+  explicit circular_buffer (const alloc_type &alloc) noexcept
+      : alloc_ (alloc), buffer_ (nullptr), capacity_ (0), head_ (0), size_ (0)
+  {
+  }
+
+  explicit circular_buffer (size_type capacity,
+			    const alloc_type &alloc = alloc_type ())
+      : circular_buffer (alloc)
+  {
+    reserve (capacity);
+  }
+
+  ~circular_buffer ()
+  {
+    clear ();
+    if (buffer_)
+      alloc_traits::deallocate (alloc_, buffer_, capacity_);
+  }
+
+  circular_buffer (const circular_buffer &) = delete;
+  circular_buffer &operator= (const circular_buffer &) = delete;
+
+  template <typename... Args>
+  T &
+  emplace_back (Args &&...args)
+  {
+    if (size_ == capacity_)
+      reserve (capacity_ ? capacity_ * 2 : 16);
+
+    T *slot = buffer_ + index (size_);
+    alloc_traits::construct (alloc_, slot, std::forward<Args> (args)...);
+    size_++;
+
+    return *slot;
+  }
+
+  template <typename U>
+  void
+  push_back (U &&elem)
+  {
+    emplace_back (std::forward<U> (elem));
+  }
+
+  void
+  pop_front ()
+  {
+    alloc_traits::destroy (alloc_, buffer_ + head_);
+    if (++head_ == capacity_)
+      head_ = 0;
+    size_--;
+  }
+
+  T &
+  front ()
+  {
+    return buffer_[head_];
+  }
+
+  const T &
+  front () const
+  {
+    return buffer_[head_];
+  }
+
+  T &
+  operator[] (size_type i)
+  {
+    return buffer_[index (i)];
+  }
+
+  const T &
+  operator[] (size_type i) const
+  {
+    return buffer_[index (i)];
+  }
+
+  void
+  reserve (size_type capacity)
+  {
+    if (capacity <= capacity_)
+      return;
+
+    T *buffer = alloc_traits::allocate (alloc_, capacity);
+    for (size_type i = 0; i < size_; i++)
+      {
+	T *elem = buffer_ + index (i);
+	alloc_traits::construct (alloc_, buffer + i, std::move (*elem));
+	alloc_traits::destroy (alloc_, elem);
+      }
+
+    if (buffer_)
+      alloc_traits::deallocate (alloc_, buffer_, capacity_);
+
+    buffer_ = buffer;
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+  void
+  clear ()
+  {
+    while (size_)
+      pop_front ();
+    head_ = 0;
+  }
+
+  size_type
+  size () const
+  {
+    return size_;
+  }
+
+  size_type
+  capacity () const
+  {
+    return capacity_;
+  }
+
+  bool
+  empty () const
+  {
+    return size_ == 0;
+  }
+
+  allocator_type
+  get_allocator () const
+  {
+    return alloc_;
+  }
+
+private:
+  size_type
+  index (size_type i) const
+  {
+    size_type pos = head_ + i;
+    return pos < capacity_ ? pos : pos - capacity_;
+  }
+
+private:
+  alloc_type alloc_;
+  T *buffer_;
+  size_type capacity_;
+  size_type head_;
+  size_type size_;
+};
+
+namespace pmr
+{
+template <typename T>
+using circular_buffer
+    = ::circular_buffer<T, std::pmr::polymorphic_allocator<T>>;
+}
+
+#endif // CIRCULAR_BUFFER_H
@@ -1,24 +1,39 @@
 #ifndef CONCURRENT_BLOCKING_QUEUE_H
 #define CONCURRENT_BLOCKING_QUEUE_H
 
-#include <deque>
 #include <mutex>
+#include <chrono>
 #include <limits>
 #include <utility>
 #include <optional>
-#include <condition_variable>
+#include <algorithm>
+#include "queue_stats.h"
+#include "circular_buffer.h"
+#include "counted_condition.h"
 
-template <typename T>
+template <typename T, typename Stats = null_queue_stats,
+	  typename Alloc = std::allocator<T>>
 class concurrent_blocking_queue
 {
 public:
   using element_type = T;
   using size_type = size_t;
+  using stats_type = Stats;
+  using allocator_type = Alloc;
+  using clock = std::chrono::steady_clock;
 
-  explicit concurrent_blocking_queue (size_type capacity
-				      = std::numeric_limits<size_type>::max ())
-      : capacity_ (capacity), closed_ (false)
+  explicit concurrent_blocking_queue (
+      size_type capacity = std::numeric_limits<size_type>::max (),
+      const Alloc &alloc = Alloc ())
+      : capacity_ (capacity), queue_ (alloc), closed_ (false),
+	stamps_ (alloc)
   {
+    if (capacity_ != std::numeric_limits<size_type>::max ())
+      {
+	queue_.reserve (capacity_);
+	if constexpr (Stats::enabled)
+	  stamps_.reserve (capacity_);
+      }
   }
 
   concurrent_blocking_queue (const concurrent_blocking_queue &) = delete;
@@ -30,14 +45,14 @@ public:
   push (U &&elem)
   {
     std::unique_lock<std::mutex> lock (mutex_);
-    not_full_cv_.wait (
-	lock, [this] { return queue_.size () < capacity_ || closed_; });
+    wait (lock, not_full_,
+	  [this] { return queue_.size () < capacity_ || closed_; });
 
     if (closed_)
       return false;
 
-    queue_.push_back (std::forward<U> (elem));
-    not_empty_cv_.notify_one ();
+    enqueue (std::forward<U> (elem));
+    notify_consumers (1);
 
     return true;
   }
@@ -47,31 +62,71 @@ public:
   try_push (U &&elem, const Duration &timeout)
   {
     std::unique_lock<std::mutex> lock (mutex_);
-    bool success = not_full_cv_.wait_for (lock, timeout, [this] {
-      return queue_.size () < capacity_ || closed_;
-    });
+    bool success
+	= wait_for (lock, not_full_, timeout,
+		    [this] { return queue_.size () < capacity_ || closed_; });
 
+    if (!success)
+      stats_.record_push_timeout ();
     if (!success || closed_)
       return false;
 
-    queue_.push_back (std::forward<U> (elem));
-    not_empty_cv_.notify_one ();
+    enqueue (std::forward<U> (elem));
+    notify_consumers (1);
 
     return true;
   }
 
+  template <typename InputIt>
+  size_type
+  push_range (InputIt first, InputIt last)
+  {
+    size_type pushed = 0;
+    std::unique_lock<std::mutex> lock (mutex_);
+
+    while (first != last)
+      {
+	wait (lock, not_full_,
+	      [this] { return queue_.size () < capacity_ || closed_; });
+
+	if (closed_)
+	  break;
+
+	size_type n = 0;
+	for (; first != last && queue_.size () < capacity_; ++first, ++n)
+	  enqueue (*first);
+	pushed += n;
+
+	notify_consumers (n);
+      }
+
+    return pushed;
+  }
+
   std::optional<T>
   pop ()
   {
     std::unique_lock<std::mutex> lock (mutex_);
-    not_empty_cv_.wait (lock, [this] { return !queue_.empty () || closed_; });
+    wait (lock, not_empty_, [this] { return !queue_.empty () || closed_; });
 
     if (queue_.empty () && closed_)
       return std::nullopt;
 
-    auto elem = std::move (queue_.front ());
-    queue_.pop_front ();
-    not_full_cv_.notify_one ();
+    auto elem = dequeue ();
+    not_full_.notify (1);
+
+    return elem;
+  }
+
+  std::optional<T>
+  try_pop ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    if (queue_.empty ())
+      return std::nullopt;
+
+    auto elem = dequeue ();
+    not_full_.notify (1);
 
     return elem;
   }
@@ -81,19 +136,65 @@ public:
   try_pop (const Duration &timeout)
   {
     std::unique_lock<std::mutex> lock (mutex_);
-    bool success = not_empty_cv_.wait_for (
-	lock, timeout, [this] { return !queue_.empty () || closed_; });
+    bool success
+	= wait_for (lock, not_empty_, timeout,
+		    [this] { return !queue_.empty () || closed_; });
 
+    if (!success)
+      stats_.record_pop_timeout ();
     if (!success || (queue_.empty () && closed_))
       return std::nullopt;
 
-    auto elem = std::move (queue_.front ());
-    queue_.pop_front ();
-    not_full_cv_.notify_one ();
+    auto elem = dequeue ();
+    not_full_.notify (1);
 
     return elem;
   }
 
+  template <typename OutputIt>
+  size_type
+  pop_batch (OutputIt out, size_type max)
+  {
+    return pop_batch (out, max, std::chrono::nanoseconds::zero ());
+  }
+
+  template <typename OutputIt, typename Duration>
+  size_type
+  pop_batch (OutputIt out, size_type max, const Duration &linger)
+  {
+    if (max == 0)
+      return 0;
+
+    std::unique_lock<std::mutex> lock (mutex_);
+    size_type n;
+
+    // another consumer may drain the queue while we linger; start over
+    // rather than return 0, which means closed and drained
+    for (;;)
+      {
+	wait (lock, not_empty_,
+	      [this] { return !queue_.empty () || closed_; });
+
+	if (queue_.size () < max && !closed_ && linger > Duration::zero ())
+	  wait_for (lock, linger_, linger, [this, max] {
+	    return queue_.size () >= max || closed_;
+	  });
+
+	n = std::min (max, queue_.size ());
+	if (n != 0 || closed_)
+	  break;
+      }
+
+    for (size_type i = 0; i < n; i++)
+      *out++ = dequeue ();
+
+    not_full_.notify (n);
+    if (!queue_.empty ())
+      not_empty_.notify (1);
+
+    return n;
+  }
+
   void
   close ()
   {
@@ -101,8 +202,9 @@ public:
       std::lock_guard<std::mutex> lock (mutex_);
       closed_ = true;
     }
-    not_empty_cv_.notify_all ();
-    not_full_cv_.notify_all ();
+    not_empty_.notify_all ();
+    not_full_.notify_all ();
+    linger_.notify_all ();
   }
 
   size_type
@@ -126,14 +228,118 @@ public:
     return closed_;
   }
 
+  const stats_type &
+  stats () const noexcept
+  {
+    return stats_;
+  }
+
+private:
+  template <typename U>
+  void
+  enqueue (U &&elem)
+  {
+    queue_.push_back (std::forward<U> (elem));
+    if constexpr (Stats::enabled)
+      {
+	stamps_.push_back (clock::now ());
+	stats_.record_push (queue_.size ());
+      }
+  }
+
+  T
+  dequeue ()
+  {
+    T elem = std::move (queue_.front ());
+    queue_.pop_front ();
+    if constexpr (Stats::enabled)
+      {
+	stats_.record_pop (clock::now () - stamps_.front ());
+	stamps_.pop_front ();
+      }
+    return elem;
+  }
+
+  // counted_condition waits that also feed the wait-time histograms
+  template <typename Pred>
+  void
+  wait (std::unique_lock<std::mutex> &lock, counted_condition &cond,
+	Pred pred)
+  {
+    if (pred ())
+      return;
+
+    auto start = stamp ();
+    cond.wait (lock, pred);
+    record_wait (cond, start);
+  }
+
+  template <typename Duration, typename Pred>
+  bool
+  wait_for (std::unique_lock<std::mutex> &lock, counted_condition &cond,
+	    const Duration &timeout, Pred pred)
+  {
+    if (pred ())
+      return true;
+
+    auto start = stamp ();
+    bool success = cond.wait_for (lock, timeout, pred);
+    record_wait (cond, start);
+
+    return success;
+  }
+
+  clock::time_point
+  stamp () const
+  {
+    if constexpr (Stats::enabled)
+      return clock::now ();
+    else
+      return clock::time_point ();
+  }
+
+  void
+  record_wait (const counted_condition &cond, clock::time_point start)
+  {
+    if constexpr (Stats::enabled)
+      {
+	auto d = clock::now () - start;
+	if (&cond == &not_full_)
+	  stats_.record_push_wait (d);
+	else
+	  stats_.record_pop_wait (d);
+      }
+  }
+
+  // lingering pop_batch callers wait on their own condition variable, so
+  // a notify_one meant for a ready pop () never lands on one of them
+  void
+  notify_consumers (size_type n)
+  {
+    not_empty_.notify (n);
+    if (linger_.waiters () != 0 && n != 0)
+      linger_.notify_all ();
+  }
+
 private:
   size_type capacity_;
-  std::deque<T> queue_;
+  circular_buffer<T, Alloc> queue_;
   mutable std::mutex mutex_;
 
   bool closed_;
-  std::condition_variable not_full_cv_;
-  std::condition_variable not_empty_cv_;
+  counted_condition not_full_;
+  counted_condition not_empty_;
+  counted_condition linger_;
+
+  Stats stats_;
+  circular_buffer<clock::time_point, Alloc> stamps_;
 };
 
+namespace pmr
+{
+template <typename T, typename Stats = null_queue_stats>
+using concurrent_blocking_queue = ::concurrent_blocking_queue<
+    T, Stats, std::pmr::polymorphic_allocator<T>>;
+}
+
 #endif // CONCURRENT_BLOCKING_QUEUE_H
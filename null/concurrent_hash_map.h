@@ -0,0 +1,415 @@
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <functional>
+
+#include "epoch_domain.h"
+
+// readers walk bucket chains without locks under an epoch guard; writers
+// serialize per lock stripe and replace a node to change it. Growing moves
+// buckets into a table twice the size a few at a time, leaving a MOVED
+// marker that sends readers on to the new table. A resize re-links
+// entries without copying or moving keys and values; find copies the
+// value out, and insert_or_assign on a present key copies the key.
+template <typename K, typename V, typename Hash = std::hash<K>,
+	  typename KeyEqual = std::equal_to<K>, size_t Stripes = 64>
+class concurrent_hash_map
+{
+  static_assert (Stripes > 0 && (Stripes & (Stripes - 1)) == 0,
+		 "Stripes must be a power of two.");
+
+  struct entry
+  {
+    K key;
+    V value;
+  };
+
+  // a resize gives each entry a new node in the bigger table, so an entry
+  // belongs to whichever node is linked into the newest table
+  struct node
+  {
+    node (size_t hash_, entry *item_, node *next_) noexcept
+	: hash (hash_), item (item_), next (next_)
+    {
+    }
+
+    size_t hash;
+    entry *item;
+    std::atomic<node *> next;
+  };
+
+  struct table
+  {
+    explicit table (size_t n)
+	: mask (n - 1), buckets (new std::atomic<node *>[n] ()),
+	  next (nullptr), claimed (0), moved (0)
+    {
+    }
+
+    size_t
+    size () const
+    {
+      return mask + 1;
+    }
+
+    std::atomic<node *> &
+    bucket (size_t hash)
+    {
+      return buckets[hash & mask];
+    }
+
+    size_t mask;
+    std::unique_ptr<std::atomic<node *>[]> buckets;
+    std::atomic<table *> next;
+    std::atomic<size_t> claimed;
+    std::atomic<size_t> moved;
+  };
+
+  struct alignas (64) stripe
+  {
+    std::mutex mutex;
+  };
+
+  // buckets migrated by a writer on its way in, on top of its own
+  static constexpr size_t help_per_op = 2;
+
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using size_type = size_t;
+
+  explicit concurrent_hash_map (size_type buckets = Stripes,
+				epoch_domain &domain = epoch_domain::global ())
+      : domain_ (domain), size_ (0)
+  {
+    size_type n = Stripes;
+    while (n < buckets)
+      n *= 2;
+    table_.store (new table (n), std::memory_order_relaxed);
+  }
+
+  ~concurrent_hash_map ()
+  {
+    table *t = table_.load (std::memory_order_relaxed);
+    while (t)
+      {
+	for (size_t i = 0; i < t->size (); i++)
+	  {
+	    node *n = t->buckets[i].load (std::memory_order_relaxed);
+	    if (n == moved ())
+	      continue;
+	    while (n)
+	      {
+		node *following = n->next.load (std::memory_order_relaxed);
+		delete n->item;
+		delete n;
+		n = following;
+	      }
+	  }
+
+	table *following = t->next.load (std::memory_order_relaxed);
+	delete t;
+	t = following;
+      }
+  }
+
+  concurrent_hash_map (const concurrent_hash_map &) = delete;
+  concurrent_hash_map &operator= (const concurrent_hash_map &) = delete;
+
+  std::optional<V>
+  find (const K &key) const
+  {
+    auto guard = domain_.pin ();
+    if (const node *n = lookup (hash_ (key), key))
+      return n->item->value;
+    return std::nullopt;
+  }
+
+  bool
+  contains (const K &key) const
+  {
+    auto guard = domain_.pin ();
+    return lookup (hash_ (key), key) != nullptr;
+  }
+
+  // returns false, leaving the map unchanged, if key is present
+  template <typename KK, typename VV>
+  bool
+  insert (KK &&key, VV &&value)
+  {
+    return update (std::forward<KK> (key), std::forward<VV> (value), false);
+  }
+
+  // returns true if key was inserted, false if it was assigned
+  template <typename KK, typename VV>
+  bool
+  insert_or_assign (KK &&key, VV &&value)
+  {
+    return update (std::forward<KK> (key), std::forward<VV> (value), true);
+  }
+
+  bool
+  erase (const K &key)
+  {
+    auto guard = domain_.pin ();
+    size_t h = hash_ (key);
+    help_resize ();
+
+    std::lock_guard<std::mutex> lock (stripe_for (h));
+    std::atomic<node *> &head = writable_bucket (h);
+
+    std::atomic<node *> *link = &head;
+    for (node *n = link->load (std::memory_order_relaxed); n;
+	 n = link->load (std::memory_order_relaxed))
+      {
+	if (n->hash == h && equal_ (n->item->key, key))
+	  {
+	    link->store (n->next.load (std::memory_order_relaxed),
+			 std::memory_order_release);
+	    domain_.retire (n->item);
+	    domain_.retire (n);
+	    size_.fetch_sub (1, std::memory_order_relaxed);
+	    return true;
+	  }
+	link = &n->next;
+      }
+
+    return false;
+  }
+
+  size_type
+  size () const
+  {
+    return size_.load (std::memory_order_relaxed);
+  }
+
+  bool
+  empty () const
+  {
+    return size () == 0;
+  }
+
+  size_type
+  bucket_count () const
+  {
+    auto guard = domain_.pin ();
+    table *t = table_.load (std::memory_order_acquire);
+    table *next = t->next.load (std::memory_order_acquire);
+    return (next ? next : t)->size ();
+  }
+
+private:
+  static node *
+  moved () noexcept
+  {
+    return reinterpret_cast<node *> (std::uintptr_t (1));
+  }
+
+  std::mutex &
+  stripe_for (size_t hash)
+  {
+    return stripes_[hash & (Stripes - 1)].mutex;
+  }
+
+  const node *
+  lookup (size_t h, const K &key) const
+  {
+    table *t = table_.load (std::memory_order_acquire);
+    for (;;)
+      {
+	node *n = t->bucket (h).load (std::memory_order_acquire);
+	if (n == moved ())
+	  {
+	    t = t->next.load (std::memory_order_acquire);
+	    continue;
+	  }
+
+	for (; n; n = n->next.load (std::memory_order_acquire))
+	  if (n->hash == h && equal_ (n->item->key, key))
+	    return n;
+	return nullptr;
+      }
+  }
+
+  template <typename KK, typename VV>
+  bool
+  update (KK &&key, VV &&value, bool assign)
+  {
+    auto guard = domain_.pin ();
+    size_t h = hash_ (key);
+    help_resize ();
+
+    bool inserted;
+    {
+      std::lock_guard<std::mutex> lock (stripe_for (h));
+      std::atomic<node *> &head = writable_bucket (h);
+
+      std::atomic<node *> *link = &head;
+      node *n = link->load (std::memory_order_relaxed);
+      for (; n; link = &n->next, n = link->load (std::memory_order_relaxed))
+	if (n->hash == h && equal_ (n->item->key, key))
+	  break;
+
+      inserted = n == nullptr;
+      if (inserted)
+	{
+	  node *fresh = make_node (h, std::forward<KK> (key),
+				   std::forward<VV> (value),
+				   head.load (std::memory_order_relaxed));
+	  head.store (fresh, std::memory_order_release);
+	}
+      else if (assign)
+	{
+	  // readers may hold n, so its replacement is a fresh node
+	  node *fresh = make_node (h, n->item->key, std::forward<VV> (value),
+				   n->next.load (std::memory_order_relaxed));
+	  link->store (fresh, std::memory_order_release);
+	  domain_.retire (n->item);
+	  domain_.retire (n);
+	}
+    }
+
+    if (inserted
+	&& size_.fetch_add (1, std::memory_order_relaxed) + 1
+	       > table_.load (std::memory_order_acquire)->size ())
+      start_resize ();
+    return inserted;
+  }
+
+  // the bucket for h in the newest table, migrating it on the way; the
+  // stripe lock for h must be held. Every table has at least Stripes
+  // buckets, so one stripe covers h's bucket in all of them.
+  std::atomic<node *> &
+  writable_bucket (size_t h)
+  {
+    table *t = table_.load (std::memory_order_acquire);
+    for (;;)
+      {
+	table *next = t->next.load (std::memory_order_acquire);
+	std::atomic<node *> &b = t->bucket (h);
+
+	if (b.load (std::memory_order_relaxed) == moved ())
+	  t = next;
+	else if (next)
+	  {
+	    migrate (t, h & t->mask);
+	    t = next;
+	  }
+	else
+	  return b;
+      }
+  }
+
+  void
+  start_resize ()
+  {
+    table *t = table_.load (std::memory_order_acquire);
+    if (t->next.load (std::memory_order_acquire))
+      return;
+
+    auto *bigger = new table (t->size () * 2);
+    table *expected = nullptr;
+    if (!t->next.compare_exchange_strong (expected, bigger,
+					  std::memory_order_acq_rel))
+      delete bigger;
+  }
+
+  void
+  help_resize ()
+  {
+    table *t = table_.load (std::memory_order_acquire);
+    if (!t->next.load (std::memory_order_acquire))
+      return;
+
+    for (size_t k = 0; k < help_per_op; k++)
+      {
+	size_t i = t->claimed.fetch_add (1, std::memory_order_relaxed);
+	if (i >= t->size ())
+	  return;
+
+	std::lock_guard<std::mutex> lock (stripe_for (i));
+	migrate (t, i);
+      }
+  }
+
+  template <typename KK, typename VV>
+  static node *
+  make_node (size_t h, KK &&key, VV &&value, node *next)
+  {
+    std::unique_ptr<entry> item (
+	new entry{ std::forward<KK> (key), std::forward<VV> (value) });
+    node *n = new node (h, item.get (), next);
+    item.release ();
+    return n;
+  }
+
+  // links the entries of bucket i of t into the next table and marks it
+  // MOVED; the stripe lock for i must be held. Readers may still be on the
+  // old chain, so it gets new nodes rather than being re-linked, and they
+  // are all allocated before the first is published.
+  void
+  migrate (table *t, size_t i)
+  {
+    std::atomic<node *> &b = t->buckets[i];
+    node *n = b.load (std::memory_order_relaxed);
+    if (n == moved ())
+      return;
+
+    node *fresh = nullptr;
+    try
+      {
+	for (; n; n = n->next.load (std::memory_order_relaxed))
+	  fresh = new node (n->hash, n->item, fresh);
+      }
+    catch (...)
+      {
+	while (fresh)
+	  delete std::exchange (fresh,
+				fresh->next.load (std::memory_order_relaxed));
+	throw;
+      }
+
+    table *next = t->next.load (std::memory_order_acquire);
+    while (fresh)
+      {
+	node *f = std::exchange (fresh,
+				 fresh->next.load (std::memory_order_relaxed));
+	std::atomic<node *> &dst = next->bucket (f->hash);
+	f->next.store (dst.load (std::memory_order_relaxed),
+		       std::memory_order_relaxed);
+	dst.store (f, std::memory_order_release);
+      }
+
+    // the entries now belong to the new nodes; only the old nodes go
+    n = b.exchange (moved (), std::memory_order_acq_rel);
+    while (n)
+      {
+	node *following = n->next.load (std::memory_order_relaxed);
+	domain_.retire (n);
+	n = following;
+      }
+
+    if (t->moved.fetch_add (1, std::memory_order_acq_rel) + 1 == t->size ())
+      {
+	table_.store (next, std::memory_order_release);
+	domain_.retire (t);
+      }
+  }
+
+private:
+  epoch_domain &domain_;
+  Hash hash_;
+  KeyEqual equal_;
+
+  std::atomic<table *> table_;
+  std::atomic<size_type> size_;
+  stripe stripes_[Stripes];
+};
+
+#endif // CONCURRENT_HASH_MAP_H
@@ -0,0 +1,78 @@
+#ifndef COUNTED_CONDITION_H
+#define COUNTED_CONDITION_H
+
+#include <mutex>
+#include <cstddef>
+#include <condition_variable>
+
+// a condition variable that counts its sleepers so notify can skip the
+// wakeup when nobody waits; the count is guarded by the caller's mutex
+class counted_condition
+{
+public:
+  using size_type = size_t;
+
+  counted_condition () : waiters_ (0) {}
+
+  counted_condition (const counted_condition &) = delete;
+  counted_condition &operator= (const counted_condition &) = delete;
+
+  template <typename Pred>
+  void
+  wait (std::unique_lock<std::mutex> &lock, Pred pred)
+  {
+    if (pred ())
+      return;
+
+    waiters_++;
+    cv_.wait (lock, pred);
+    waiters_--;
+  }
+
+  template <typename Duration, typename Pred>
+  bool
+  wait_for (std::unique_lock<std::mutex> &lock, const Duration &timeout,
+	    Pred pred)
+  {
+    if (pred ())
+      return true;
+
+    waiters_++;
+    bool success = cv_.wait_for (lock, timeout, pred);
+    waiters_--;
+
+    return success;
+  }
+
+  // wakes one sleeper for a single item and all of them for more
+  void
+  notify (size_type n)
+  {
+    if (waiters_ == 0 || n == 0)
+      return;
+
+    if (n == 1)
+      cv_.notify_one ();
+    else
+      cv_.notify_all ();
+  }
+
+  // for close (); may be called without the mutex held
+  void
+  notify_all ()
+  {
+    cv_.notify_all ();
+  }
+
+  size_type
+  waiters () const noexcept
+  {
+    return waiters_;
+  }
+
+private:
+  std::condition_variable cv_;
+  size_type waiters_;
+};
+
+#endif // COUNTED_CONDITION_H
@@ -0,0 +1,183 @@
+#ifndef EPOCH_DOMAIN_H
+#define EPOCH_DOMAIN_H
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include "reclamation.h"
+
+class epoch_domain
+{
+  struct record : public thread_record
+  {
+    // (epoch << 1) | 1 while pinned, 0 otherwise
+    std::atomic<std::uint64_t> state{ 0 };
+    unsigned depth = 0;
+    std::vector<std::pair<retired_ptr, std::uint64_t>> retired;
+  };
+
+public:
+  class guard
+  {
+    friend class epoch_domain;
+
+  public:
+    ~guard ()
+    {
+      if (--rec_.depth == 0)
+	rec_.state.store (0, std::memory_order_release);
+    }
+
+    guard (const guard &) = delete;
+    guard &operator= (const guard &) = delete;
+
+  private:
+    explicit guard (epoch_domain &domain) : rec_ (domain.registry_.local ())
+    {
+      if (rec_.depth++ != 0)
+	return;
+
+      std::uint64_t e = domain.epoch_.load (std::memory_order_relaxed);
+      rec_.state.store ((e << 1) | 1, std::memory_order_relaxed);
+      std::atomic_thread_fence (std::memory_order_seq_cst);
+    }
+
+  private:
+    record &rec_;
+  };
+
+  explicit epoch_domain (size_t batch = 64) : epoch_ (0), batch_ (batch) {}
+
+  ~epoch_domain ()
+  {
+    registry_.for_each ([] (record &r) {
+      while (!r.retired.empty ())
+	for (auto &p : std::exchange (r.retired, {}))
+	  p.first ();
+    });
+    for (auto &p : orphans_)
+      p.first ();
+  }
+
+  epoch_domain (const epoch_domain &) = delete;
+  epoch_domain &operator= (const epoch_domain &) = delete;
+
+  static epoch_domain &
+  global ()
+  {
+    static epoch_domain domain;
+    return domain;
+  }
+
+  guard
+  pin ()
+  {
+    return guard (*this);
+  }
+
+  template <typename T>
+  void
+  retire (T *ptr)
+  {
+    retire (make_retired (ptr));
+  }
+
+  void
+  retire (retired_ptr ptr)
+  {
+    record &rec = registry_.local ();
+    rec.retired.emplace_back (ptr, epoch_.load (std::memory_order_acquire));
+
+    if (rec.retired.size () >= batch_)
+      {
+	try_advance ();
+	reclaim (rec);
+      }
+  }
+
+  // frees whatever the current epoch allows for the calling thread
+  void
+  reclaim ()
+  {
+    try_advance ();
+    reclaim (registry_.local ());
+  }
+
+private:
+  bool
+  try_advance ()
+  {
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+    std::uint64_t e = epoch_.load (std::memory_order_acquire);
+    bool ready = true;
+
+    registry_.for_each ([e, &ready] (record &r) {
+      std::uint64_t s = r.state.load (std::memory_order_acquire);
+      if ((s & 1) && (s >> 1) != e)
+	ready = false;
+    });
+
+    adopt_orphans ();
+    if (!ready)
+      return false;
+
+    return epoch_.compare_exchange_strong (e, e + 1,
+					   std::memory_order_acq_rel);
+  }
+
+  // the list is taken before any callback runs, since a deleter may
+  // retire more and re-enter reclaim
+  void
+  reclaim (record &rec)
+  {
+    std::uint64_t e = epoch_.load (std::memory_order_acquire);
+    auto list = std::exchange (rec.retired, {});
+
+    auto ready = std::partition (list.begin (), list.end (),
+				 [e] (auto &p) { return p.second + 2 > e; });
+    rec.retired.insert (rec.retired.end (), list.begin (), ready);
+
+    for (auto it = ready; it != list.end (); ++it)
+      it->first ();
+  }
+
+  void
+  adopt_orphans ()
+  {
+    std::uint64_t e = epoch_.load (std::memory_order_acquire);
+    std::vector<std::pair<retired_ptr, std::uint64_t>> ready;
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      registry_.collect ([this] (record &r) {
+	orphans_.insert (orphans_.end (), r.retired.begin (),
+			 r.retired.end ());
+	r.retired.clear ();
+      });
+
+      size_t kept = 0;
+      for (size_t i = 0; i < orphans_.size (); i++)
+	if (orphans_[i].second + 2 <= e)
+	  ready.push_back (orphans_[i]);
+	else
+	  orphans_[kept++] = orphans_[i];
+      orphans_.resize (kept);
+    }
+
+    for (auto &p : ready)
+      p.first ();
+  }
+
+private:
+  std::atomic<std::uint64_t> epoch_;
+  size_t batch_;
+  thread_registry<record> registry_;
+
+  std::mutex mutex_;
+  std::vector<std::pair<retired_ptr, std::uint64_t>> orphans_;
+};
+
+#endif // EPOCH_DOMAIN_H
@@ -0,0 +1,234 @@
+#ifndef HAZARD_POINTER_H
+#define HAZARD_POINTER_H
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "reclamation.h"
+
+class hazard_domain
+{
+public:
+  static constexpr size_t slots_per_thread = 8;
+
+private:
+  struct record : public thread_record
+  {
+    std::atomic<void *> slots[slots_per_thread] = {};
+    std::atomic<unsigned> used{ 0 };
+    std::vector<retired_ptr> retired;
+  };
+
+public:
+  class hazard_pointer
+  {
+    friend class hazard_domain;
+
+  public:
+    hazard_pointer () noexcept : rec_ (nullptr), index_ (0) {}
+
+    ~hazard_pointer ()
+    {
+      if (!rec_)
+	return;
+
+      // a moved hazard_pointer may be destroyed on another thread
+      reset_protection ();
+      rec_->used.fetch_and (~(1u << index_), std::memory_order_release);
+    }
+
+    hazard_pointer (hazard_pointer &&other) noexcept
+	: rec_ (std::exchange (other.rec_, nullptr)), index_ (other.index_)
+    {
+    }
+
+    hazard_pointer &
+    operator= (hazard_pointer &&other) noexcept
+    {
+      hazard_pointer (std::move (other)).swap (*this);
+      return *this;
+    }
+
+    void
+    swap (hazard_pointer &other) noexcept
+    {
+      using std::swap;
+      swap (rec_, other.rec_);
+      swap (index_, other.index_);
+    }
+
+    bool
+    empty () const noexcept
+    {
+      return rec_ == nullptr;
+    }
+
+    template <typename T>
+    T *
+    protect (const std::atomic<T *> &src)
+    {
+      T *ptr = src.load (std::memory_order_relaxed);
+      while (!try_protect (ptr, src))
+	;
+      return ptr;
+    }
+
+    // publishes ptr, then checks that src still holds it; on failure ptr
+    // is updated to the value src holds now
+    template <typename T>
+    bool
+    try_protect (T *&ptr, const std::atomic<T *> &src)
+    {
+      T *expected = ptr;
+      reset_protection (expected);
+
+      ptr = src.load (std::memory_order_seq_cst);
+      if (ptr == expected)
+	return true;
+
+      reset_protection ();
+      return false;
+    }
+
+    template <typename T>
+    void
+    reset_protection (T *ptr) noexcept
+    {
+      rec_->slots[index_].store (static_cast<void *> (ptr),
+				 std::memory_order_seq_cst);
+    }
+
+    void
+    reset_protection () noexcept
+    {
+      rec_->slots[index_].store (nullptr, std::memory_order_release);
+    }
+
+  private:
+    hazard_pointer (record *rec, unsigned index) noexcept
+	: rec_ (rec), index_ (index)
+    {
+    }
+
+  private:
+    record *rec_;
+    unsigned index_;
+  };
+
+  explicit hazard_domain (size_t threshold = 64) : threshold_ (threshold) {}
+
+  ~hazard_domain ()
+  {
+    registry_.for_each ([] (record &r) {
+      while (!r.retired.empty ())
+	for (auto &p : std::exchange (r.retired, {}))
+	  p ();
+    });
+    for (auto &p : orphans_)
+      p ();
+  }
+
+  hazard_domain (const hazard_domain &) = delete;
+  hazard_domain &operator= (const hazard_domain &) = delete;
+
+  static hazard_domain &
+  global ()
+  {
+    static hazard_domain domain;
+    return domain;
+  }
+
+  hazard_pointer
+  make_hazard_pointer ()
+  {
+    record &rec = registry_.local ();
+    unsigned used = rec.used.load (std::memory_order_acquire);
+    for (unsigned i = 0; i < slots_per_thread; i++)
+      if (!(used & (1u << i)))
+	{
+	  rec.used.fetch_or (1u << i, std::memory_order_relaxed);
+	  return hazard_pointer (&rec, i);
+	}
+
+    throw std::runtime_error ("hazard_domain: out of hazard pointers");
+  }
+
+  template <typename T>
+  void
+  retire (T *ptr)
+  {
+    retire (make_retired (ptr));
+  }
+
+  void
+  retire (retired_ptr ptr)
+  {
+    record &rec = registry_.local ();
+    rec.retired.push_back (ptr);
+
+    if (rec.retired.size () >= threshold_)
+      scan (rec);
+  }
+
+  // frees every retired pointer of the calling thread that no hazard
+  // pointer protects
+  void
+  reclaim ()
+  {
+    scan (registry_.local ());
+  }
+
+private:
+  // pointers retired by exited threads are adopted before the hazard
+  // snapshot, so every pointer scanned was unlinked before it was taken
+  void
+  scan (record &rec)
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      registry_.collect ([this] (record &r) {
+	orphans_.insert (orphans_.end (), r.retired.begin (),
+			 r.retired.end ());
+	r.retired.clear ();
+      });
+      rec.retired.insert (rec.retired.end (), orphans_.begin (),
+			  orphans_.end ());
+      orphans_.clear ();
+    }
+
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+
+    std::vector<void *> hazards;
+    registry_.for_each ([&hazards] (record &r) {
+      for (auto &slot : r.slots)
+	if (void *p = slot.load (std::memory_order_seq_cst))
+	  hazards.push_back (p);
+    });
+    std::sort (hazards.begin (), hazards.end ());
+
+    // a deleter may retire more and re-enter scan, so the list is put
+    // back before any of them runs
+    auto list = std::exchange (rec.retired, {});
+    auto hazardous = [&hazards] (const retired_ptr &p) {
+      return std::binary_search (hazards.begin (), hazards.end (), p.ptr);
+    };
+    auto unprotected = std::partition (list.begin (), list.end (), hazardous);
+    rec.retired.insert (rec.retired.end (), list.begin (), unprotected);
+
+    for (auto it = unprotected; it != list.end (); ++it)
+      (*it) ();
+  }
+
+private:
+  size_t threshold_;
+  thread_registry<record> registry_;
+
+  std::mutex mutex_;
+  std::vector<retired_ptr> orphans_;
+};
+
+#endif // HAZARD_POINTER_H
@@ -0,0 +1,341 @@
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+enum class page_kind
+{
+  hugetlb,     // explicit huge pages from the hugetlbfs pool
+  transparent, // normal mapping advised for transparent huge pages
+  normal
+};
+
+struct page_mapping
+{
+  void *addr;
+  size_t size;
+  size_t page_size;
+  page_kind kind;
+};
+
+// bytes mapped by kind, summed over every live mapping
+struct huge_page_usage
+{
+  std::atomic<size_t> hugetlb{ 0 };
+  std::atomic<size_t> transparent{ 0 };
+  std::atomic<size_t> normal{ 0 };
+
+  static huge_page_usage &
+  global ()
+  {
+    static huge_page_usage usage;
+    return usage;
+  }
+
+  std::atomic<size_t> &
+  operator[] (page_kind kind)
+  {
+    return kind == page_kind::hugetlb	    ? hugetlb
+	   : kind == page_kind::transparent ? transparent
+					    : normal;
+  }
+};
+
+inline size_t
+base_page_size ()
+{
+  static const size_t size = static_cast<size_t> (::sysconf (_SC_PAGESIZE));
+  return size;
+}
+
+// default huge page size from /proc/meminfo, 2 MiB if unknown
+inline size_t
+huge_page_size ()
+{
+  static const size_t size = [] {
+    size_t kb = 0;
+    if (FILE *f = std::fopen ("/proc/meminfo", "r"))
+      {
+	char line[128];
+	while (std::fgets (line, sizeof (line), f))
+	  if (std::sscanf (line, "Hugepagesize: %zu kB", &kb) == 1)
+	    break;
+	std::fclose (f);
+      }
+    return kb ? kb * 1024 : size_t (2) << 20;
+  }();
+  return size;
+}
+
+constexpr int local_node = -1;
+constexpr int any_node = -2;
+
+inline int
+current_node ()
+{
+  unsigned cpu = 0, node = 0;
+  if (::syscall (SYS_getcpu, &cpu, &node, nullptr) != 0)
+    return -1;
+  return static_cast<int> (node);
+}
+
+// prefers node for pages not yet touched; the kernel falls back to other
+// nodes when it runs short, and failures (no NUMA) are ignored
+inline void
+bind_to_node (void *addr, size_t size, int node)
+{
+  constexpr int mpol_preferred = 1;
+
+  if (node == local_node)
+    node = current_node ();
+  if (node < 0 || node >= 64)
+    return;
+
+  unsigned long mask = 1ul << node;
+  ::syscall (SYS_mbind, addr, size, mpol_preferred, &mask, 64ul, 0u);
+}
+
+// maps size bytes rounded up to the huge page size; tries hugetlb pages,
+// then a huge-aligned mapping advised for THP, then plain pages
+inline page_mapping
+map_pages (size_t size, int node = local_node)
+{
+  size_t huge = huge_page_size ();
+  size_t len = (size + huge - 1) / huge * huge;
+  int prot = PROT_READ | PROT_WRITE;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  page_mapping m{ nullptr, len, huge, page_kind::hugetlb };
+
+  void *p = ::mmap (nullptr, len, prot, flags | MAP_HUGETLB, -1, 0);
+  if (p == MAP_FAILED)
+    {
+      // over-map so a huge-aligned range can be trimmed out of it
+      p = ::mmap (nullptr, len + huge, prot, flags, -1, 0);
+      if (p == MAP_FAILED)
+	throw std::bad_alloc ();
+
+      auto base = reinterpret_cast<std::uintptr_t> (p);
+      auto aligned = (base + huge - 1) / huge * huge;
+      if (aligned > base)
+	::munmap (p, aligned - base);
+      if (size_t tail = base + len + huge - (aligned + len))
+	::munmap (reinterpret_cast<void *> (aligned + len), tail);
+      p = reinterpret_cast<void *> (aligned);
+
+      m.page_size = base_page_size ();
+      m.kind = ::madvise (p, len, MADV_HUGEPAGE) == 0 ? page_kind::transparent
+						      : page_kind::normal;
+    }
+
+  m.addr = p;
+  if (node != any_node)
+    bind_to_node (p, len, node);
+
+  huge_page_usage::global ()[m.kind] += len;
+  return m;
+}
+
+inline void
+unmap_pages (const page_mapping &m) noexcept
+{
+  ::munmap (m.addr, m.size);
+  huge_page_usage::global ()[m.kind] -= m.size;
+}
+
+// bytes of [addr, addr + size) backed by transparent huge pages right
+// now, read from /proc/self/smaps
+inline size_t
+resident_huge_bytes (const void *addr, size_t size)
+{
+  auto lo = reinterpret_cast<std::uintptr_t> (addr);
+  auto hi = lo + size;
+  size_t total = 0;
+
+  FILE *f = std::fopen ("/proc/self/smaps", "r");
+  if (!f)
+    return 0;
+
+  char line[256];
+  bool inside = false;
+  while (std::fgets (line, sizeof (line), f))
+    {
+      std::uintptr_t start, end;
+      size_t kb;
+      if (std::sscanf (line, "%lx-%lx ", &start, &end) == 2)
+	inside = start < hi && end > lo;
+      else if (inside && std::sscanf (line, "AnonHugePages: %zu kB", &kb) == 1)
+	total += kb * 1024;
+    }
+
+  std::fclose (f);
+  return total;
+}
+
+// small requests are not worth a huge page and go to operator new
+inline bool
+wants_huge_pages (size_t size, size_t align)
+{
+  return size >= huge_page_size () / 2 && align <= huge_page_size ();
+}
+
+// remembers what each mapping got so it can be unmapped and accounted
+class page_registry
+{
+public:
+  static page_registry &
+  global ()
+  {
+    static page_registry registry;
+    return registry;
+  }
+
+  void *
+  map (size_t size, int node)
+  {
+    page_mapping m = map_pages (size, node);
+    try
+      {
+	std::lock_guard<std::mutex> lock (mutex_);
+	mappings_.emplace (m.addr, m);
+      }
+    catch (...)
+      {
+	unmap_pages (m);
+	throw;
+      }
+    return m.addr;
+  }
+
+  void
+  unmap (void *addr) noexcept
+  {
+    page_mapping m;
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      auto it = mappings_.find (addr);
+      if (it == mappings_.end ())
+	return;
+      m = it->second;
+      mappings_.erase (it);
+    }
+    unmap_pages (m);
+  }
+
+  // page size a live mapping actually got, 0 for unknown addresses
+  size_t
+  page_size (const void *addr)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    auto it = mappings_.find (const_cast<void *> (addr));
+    return it == mappings_.end () ? 0 : it->second.page_size;
+  }
+
+private:
+  std::mutex mutex_;
+  std::unordered_map<void *, page_mapping> mappings_;
+};
+
+inline void *
+allocate_pages (size_t size, size_t align, int node = local_node)
+{
+  if (wants_huge_pages (size, align))
+    return page_registry::global ().map (size, node);
+  return ::operator new (size, std::align_val_t (align));
+}
+
+inline void
+deallocate_pages (void *ptr, size_t size, size_t align) noexcept
+{
+  if (wants_huge_pages (size, align))
+    page_registry::global ().unmap (ptr);
+  else
+    ::operator delete (ptr, std::align_val_t (align));
+}
+
+template <typename T>
+class huge_page_allocator
+{
+public:
+  using value_type = T;
+
+  huge_page_allocator () noexcept = default;
+
+  template <typename U>
+  huge_page_allocator (const huge_page_allocator<U> &) noexcept
+  {
+  }
+
+  T *
+  allocate (size_t n)
+  {
+    return static_cast<T *> (allocate_pages (n * sizeof (T), alignof (T)));
+  }
+
+  void
+  deallocate (T *ptr, size_t n) noexcept
+  {
+    deallocate_pages (ptr, n * sizeof (T), alignof (T));
+  }
+
+  friend bool
+  operator== (const huge_page_allocator &, const huge_page_allocator &)
+  {
+    return true;
+  }
+
+  friend bool
+  operator!= (const huge_page_allocator &, const huge_page_allocator &)
+  {
+    return false;
+  }
+};
+
+class huge_page_resource : public std::pmr::memory_resource
+{
+public:
+  explicit huge_page_resource (int node = local_node) noexcept : node_ (node)
+  {
+  }
+
+  static huge_page_resource *
+  global ()
+  {
+    static huge_page_resource resource;
+    return &resource;
+  }
+
+private:
+  void *
+  do_allocate (size_t bytes, size_t align) override
+  {
+    return allocate_pages (bytes, align, node_);
+  }
+
+  void
+  do_deallocate (void *ptr, size_t bytes, size_t align) override
+  {
+    deallocate_pages (ptr, bytes, align);
+  }
+
+  bool
+  do_is_equal (const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  int node_;
+};
+
+#endif // HUGE_PAGES_H
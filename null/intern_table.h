@@ -0,0 +1,123 @@
+#ifndef INTERN_TABLE_H
+#define INTERN_TABLE_H
+
+#include <mutex>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+
+#include "weak_ptr.h"
+
+// maps keys to weak_ptr<T>; equal keys share one live object, and an
+// entry is erased when the object it names is disposed
+template <typename K, typename T, typename Hash = std::hash<K>,
+	  size_t Shards = 16>
+class intern_table
+{
+  static_assert (Shards > 0, "intern_table needs at least one shard");
+
+  struct alignas (64) shard
+  {
+    // recursive so a deleter firing under the lock (failed construction,
+    // or a value interning its own parts) can still erase its entry
+    std::recursive_mutex mutex;
+    std::unordered_map<K, weak_ptr<T>, Hash> map;
+  };
+
+  struct state
+  {
+    Hash hash;
+    shard shards[Shards];
+
+    shard &
+    shard_for (const K &key)
+    {
+      size_t h = hash (key);
+      return shards[(h ^ (h >> 16)) % Shards];
+    }
+
+    void
+    erase (const K &key)
+    {
+      shard &s = shard_for (key);
+      std::lock_guard<std::recursive_mutex> lock (s.mutex);
+
+      // a newer object may already be interned under the same key
+      auto it = s.map.find (key);
+      if (it != s.map.end () && it->second.expired ())
+	s.map.erase (it);
+    }
+  };
+
+  struct deleter
+  {
+    weak_ptr<state> owner;
+    K key;
+
+    void
+    operator() (T *ptr)
+    {
+      delete ptr;
+      if (auto st = owner.lock ())
+	st->erase (key);
+    }
+  };
+
+public:
+  using size_type = size_t;
+
+  intern_table () : state_ (make_shared<state> ()) {}
+
+  intern_table (const intern_table &) = delete;
+  intern_table &operator= (const intern_table &) = delete;
+
+  // returns the live object for key, or builds T (args...) under the
+  // shard lock so concurrent callers never build it twice
+  template <typename... Args>
+  shared_ptr<T>
+  intern (const K &key, Args &&...args)
+  {
+    shard &s = state_->shard_for (key);
+    std::lock_guard<std::recursive_mutex> lock (s.mutex);
+
+    auto it = s.map.find (key);
+    if (it != s.map.end ())
+      if (auto sp = it->second.lock ())
+	return sp;
+
+    shared_ptr<T> sp (new T (std::forward<Args> (args)...),
+		      deleter{ state_, key });
+    s.map[key] = sp;
+    return sp;
+  }
+
+  shared_ptr<T>
+  find (const K &key)
+  {
+    shard &s = state_->shard_for (key);
+    std::lock_guard<std::recursive_mutex> lock (s.mutex);
+
+    auto it = s.map.find (key);
+    if (it == s.map.end ())
+      return {};
+    return it->second.lock ();
+  }
+
+  // entries whose object is being disposed may still be counted
+  size_type
+  size ()
+  {
+    size_type n = 0;
+    for (auto &s : state_->shards)
+      {
+	std::lock_guard<std::recursive_mutex> lock (s.mutex);
+	n += s.map.size ();
+      }
+    return n;
+  }
+
+private:
+  shared_ptr<state> state_;
+};
+
+#endif // INTERN_TABLE_H
@@ -0,0 +1,246 @@
+#ifndef INTRUSIVE_PTR_H
+#define INTRUSIVE_PTR_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+struct thread_safe_counter
+{
+  using type = std::atomic<long>;
+
+  static long
+  load (const type &count) noexcept
+  {
+    return count.load (std::memory_order_relaxed);
+  }
+
+  static void
+  increment (type &count) noexcept
+  {
+    count.fetch_add (1, std::memory_order_relaxed);
+  }
+
+  static long
+  decrement (type &count) noexcept
+  {
+    return count.fetch_sub (1, std::memory_order_acq_rel) - 1;
+  }
+};
+
+struct thread_unsafe_counter
+{
+  using type = long;
+
+  static long
+  load (const type &count) noexcept
+  {
+    return count;
+  }
+
+  static void
+  increment (type &count) noexcept
+  {
+    count++;
+  }
+
+  static long
+  decrement (type &count) noexcept
+  {
+    return --count;
+  }
+};
+
+template <typename Derived, typename Counter = thread_safe_counter>
+class intrusive_ref_counter
+{
+public:
+  intrusive_ref_counter () noexcept : refs_ (0) {}
+
+  intrusive_ref_counter (const intrusive_ref_counter &) noexcept : refs_ (0)
+  {
+  }
+
+  intrusive_ref_counter &
+  operator= (const intrusive_ref_counter &) noexcept
+  {
+    return *this;
+  }
+
+  long
+  use_count () const noexcept
+  {
+    return Counter::load (refs_);
+  }
+
+  friend void
+  intrusive_ptr_add_ref (const intrusive_ref_counter *p) noexcept
+  {
+    Counter::increment (p->refs_);
+  }
+
+  friend void
+  intrusive_ptr_release (const intrusive_ref_counter *p) noexcept
+  {
+    if (Counter::decrement (p->refs_) == 0)
+      delete static_cast<const Derived *> (p);
+  }
+
+protected:
+  ~intrusive_ref_counter () = default;
+
+private:
+  mutable typename Counter::type refs_;
+};
+
+template <typename T>
+class intrusive_ptr
+{
+  template <typename U>
+  friend class intrusive_ptr;
+
+public:
+  using element_type = T;
+
+  intrusive_ptr (std::nullptr_t = nullptr) noexcept : ptr_ (nullptr) {}
+
+  explicit intrusive_ptr (T *ptr, bool add_ref = true) : ptr_ (ptr)
+  {
+    if (ptr_ && add_ref)
+      intrusive_ptr_add_ref (ptr_);
+  }
+
+  ~intrusive_ptr ()
+  {
+    if (ptr_)
+      intrusive_ptr_release (ptr_);
+  }
+
+  intrusive_ptr (const intrusive_ptr &other) : ptr_ (other.ptr_)
+  {
+    if (ptr_)
+      intrusive_ptr_add_ref (ptr_);
+  }
+
+  intrusive_ptr &
+  operator= (const intrusive_ptr &other)
+  {
+    intrusive_ptr (other).swap (*this);
+    return *this;
+  }
+
+  template <typename U>
+  intrusive_ptr (const intrusive_ptr<U> &other) : ptr_ (other.ptr_)
+  {
+    static_assert (std::is_convertible<U *, T *>::value,
+		   "U* must be convertible to T*");
+    if (ptr_)
+      intrusive_ptr_add_ref (ptr_);
+  }
+
+  template <typename U>
+  intrusive_ptr &
+  operator= (const intrusive_ptr<U> &other)
+  {
+    intrusive_ptr (other).swap (*this);
+    return *this;
+  }
+
+  intrusive_ptr (intrusive_ptr &&other) noexcept
+      : ptr_ (std::exchange (other.ptr_, nullptr))
+  {
+  }
+
+  intrusive_ptr &
+  operator= (intrusive_ptr &&other) noexcept
+  {
+    intrusive_ptr (std::move (other)).swap (*this);
+    return *this;
+  }
+
+  template <typename U>
+  intrusive_ptr (intrusive_ptr<U> &&other) noexcept
+      : ptr_ (std::exchange (other.ptr_, nullptr))
+  {
+    static_assert (std::is_convertible<U *, T *>::value,
+		   "U* must be convertible to T*");
+  }
+
+  template <typename U>
+  intrusive_ptr &
+  operator= (intrusive_ptr<U> &&other) noexcept
+  {
+    intrusive_ptr (std::move (other)).swap (*this);
+    return *this;
+  }
+
+  void
+  swap (intrusive_ptr &other) noexcept
+  {
+    using std::swap;
+    swap (ptr_, other.ptr_);
+  }
+
+  T &
+  operator* () const noexcept
+  {
+    return *ptr_;
+  }
+
+  T *
+  operator->() const noexcept
+  {
+    return ptr_;
+  }
+
+  explicit
+  operator bool () const noexcept
+  {
+    return ptr_;
+  }
+
+  T *
+  get () const noexcept
+  {
+    return ptr_;
+  }
+
+  T *
+  detach () noexcept
+  {
+    return std::exchange (ptr_, nullptr);
+  }
+
+  void
+  reset (T *ptr = nullptr, bool add_ref = true)
+  {
+    intrusive_ptr (ptr, add_ref).swap (*this);
+  }
+
+private:
+  T *ptr_;
+};
+
+template <typename T, typename U>
+inline bool
+operator== (const intrusive_ptr<T> &a, const intrusive_ptr<U> &b) noexcept
+{
+  return a.get () == b.get ();
+}
+
+template <typename T, typename U>
+inline bool
+operator!= (const intrusive_ptr<T> &a, const intrusive_ptr<U> &b) noexcept
+{
+  return a.get () != b.get ();
+}
+
+template <typename T, typename... Args>
+intrusive_ptr<T>
+make_intrusive (Args &&...args)
+{
+  return intrusive_ptr<T> (new T (std::forward<Args> (args)...));
+}
+
+#endif // INTRUSIVE_PTR_H
@@ -0,0 +1,21 @@
+#ifndef LOCAL_SHARED_PTR_H
+#define LOCAL_SHARED_PTR_H
+
+#include "weak_ptr.h"
+
+// shared_ptr with plain counters, for objects confined to one thread
+// (e.g. a single io_context); it does not convert to or from shared_ptr
+template <typename T>
+using local_shared_ptr = shared_ptr<T, local_refcount<>>;
+
+template <typename T>
+using local_weak_ptr = weak_ptr<T, local_refcount<>>;
+
+template <typename T, typename... Args>
+local_shared_ptr<T>
+make_local_shared (Args &&...args)
+{
+  return make_shared<T, local_refcount<>> (std::forward<Args> (args)...);
+}
+
+#endif // LOCAL_SHARED_PTR_H
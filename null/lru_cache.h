@@ -2,19 +2,33 @@
 #define LRU_CACHE_H
 
 #include <list>
+#include <memory>
 #include <stdexcept>
+#include <functional>
 #include <unordered_map>
+#include <memory_resource>
 
-template <typename K, typename V>
+template <typename K, typename V, typename Hash = std::hash<K>,
+	  typename KeyEqual = std::equal_to<K>,
+	  typename Alloc = std::allocator<std::pair<K, V>>>
 class lru_cache
 {
   using value_type = std::pair<K, V>;
-  using list_iterator = typename std::list<value_type>::iterator;
+  using alloc_traits = std::allocator_traits<Alloc>;
+  using list_type = std::list<
+      value_type, typename alloc_traits::template rebind_alloc<value_type>>;
+  using list_iterator = typename list_type::iterator;
+  using map_value = std::pair<const K, list_iterator>;
+  using map_type = std::unordered_map<
+      K, list_iterator, Hash, KeyEqual,
+      typename alloc_traits::template rebind_alloc<map_value>>;
 
 public:
   using size_type = size_t;
+  using allocator_type = Alloc;
 
-  explicit lru_cache (size_type capacity) : capacity_ (capacity)
+  explicit lru_cache (size_type capacity, const Alloc &alloc = Alloc ())
+      : capacity_ (capacity), list_ (alloc), map_ (alloc)
   {
     if (capacity_ == 0)
       throw std::invalid_argument ("LRUCache capacity must be positive.");
@@ -56,8 +70,17 @@ public:
 
 private:
   size_type capacity_;
-  std::list<value_type> list_;
-  std::unordered_map<K, list_iterator> map_;
+  list_type list_;
+  map_type map_;
 };
 
+namespace pmr
+{
+template <typename K, typename V, typename Hash = std::hash<K>,
+	  typename KeyEqual = std::equal_to<K>>
+using lru_cache
+    = ::lru_cache<K, V, Hash, KeyEqual,
+		  std::pmr::polymorphic_allocator<std::pair<K, V>>>;
+}
+
 #endif // LRU_CACHE_H
@@ -0,0 +1,237 @@
+#ifndef MONOTONIC_ARENA_H
+#define MONOTONIC_ARENA_H
+
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <memory_resource>
+
+#include "unique_ptr.h"
+
+// runs the destructor only; the memory goes back with the arena
+template <typename T>
+struct arena_deleter
+{
+  void
+  operator() (T *ptr) const noexcept
+  {
+    ptr->~T ();
+  }
+};
+
+template <typename T>
+using arena_ptr = unique_ptr<T, arena_deleter<T>>;
+
+// bump-pointer allocator over a chain of blocks from an upstream
+// resource; nothing is freed until reset or destruction
+class monotonic_arena
+{
+  struct block
+  {
+    block *prev;
+    size_t size;
+  };
+
+public:
+  using size_type = size_t;
+
+  struct marker
+  {
+    block *head;
+    char *cur;
+    size_t used;
+  };
+
+  explicit monotonic_arena (
+      size_type block_size = 4096, size_type max_block_size = 1 << 20,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource ())
+      : head_ (nullptr), cur_ (nullptr), end_ (nullptr),
+	first_size_ (std::max (block_size, sizeof (block) * 2)),
+	next_size_ (first_size_),
+	max_size_ (std::max (max_block_size, first_size_)), used_ (0),
+	held_ (0), upstream_ (upstream)
+  {
+  }
+
+  ~monotonic_arena () { release (); }
+
+  monotonic_arena (const monotonic_arena &) = delete;
+  monotonic_arena &operator= (const monotonic_arena &) = delete;
+
+  void *
+  allocate (size_type size, size_type align = alignof (std::max_align_t))
+  {
+    char *p = align_up (cur_, align);
+    if (!cur_ || p > end_ || size > static_cast<size_type> (end_ - p))
+      {
+	grow (size, align);
+	p = align_up (cur_, align);
+      }
+
+    cur_ = p + size;
+    used_ += size;
+    return p;
+  }
+
+  template <typename T, typename... Args>
+  T *
+  create (Args &&...args)
+  {
+    void *p = allocate (sizeof (T), alignof (T));
+    return ::new (p) T (std::forward<Args> (args)...);
+  }
+
+  template <typename T, typename... Args>
+  arena_ptr<T>
+  make_unique (Args &&...args)
+  {
+    return arena_ptr<T> (create<T> (std::forward<Args> (args)...));
+  }
+
+  marker
+  mark () const noexcept
+  {
+    return { head_, cur_, used_ };
+  }
+
+  // frees every block taken after m and rewinds to it; objects
+  // created since must already be destroyed
+  void
+  reset (marker m) noexcept
+  {
+    while (head_ != m.head)
+      pop_block ();
+
+    cur_ = m.cur;
+    end_ = head_ ? reinterpret_cast<char *> (head_) + head_->size : nullptr;
+    used_ = m.used;
+    if (!head_)
+      next_size_ = first_size_;
+  }
+
+  // keeps the first block for reuse
+  void
+  reset () noexcept
+  {
+    while (head_ && head_->prev)
+      pop_block ();
+
+    cur_ = head_ ? reinterpret_cast<char *> (head_ + 1) : nullptr;
+    end_ = head_ ? reinterpret_cast<char *> (head_) + head_->size : nullptr;
+    next_size_ = head_ ? std::min (first_size_ * 2, max_size_) : first_size_;
+    used_ = 0;
+  }
+
+  void
+  release () noexcept
+  {
+    reset (marker{ nullptr, nullptr, 0 });
+  }
+
+  // bytes handed out and not yet rewound
+  size_type
+  used () const noexcept
+  {
+    return used_;
+  }
+
+  // bytes currently taken from upstream
+  size_type
+  held () const noexcept
+  {
+    return held_;
+  }
+
+  std::pmr::memory_resource *
+  upstream () const noexcept
+  {
+    return upstream_;
+  }
+
+private:
+  static char *
+  align_up (char *p, size_type align) noexcept
+  {
+    auto v = reinterpret_cast<std::uintptr_t> (p);
+    return reinterpret_cast<char *> ((v + align - 1) & ~(align - 1));
+  }
+
+  void
+  grow (size_type size, size_type align)
+  {
+    size_type need = sizeof (block) + size + align;
+    size_type bytes = std::max (next_size_, need);
+
+    auto *b = static_cast<block *> (
+	upstream_->allocate (bytes, alignof (std::max_align_t)));
+    b->prev = head_;
+    b->size = bytes;
+
+    head_ = b;
+    cur_ = reinterpret_cast<char *> (b + 1);
+    end_ = reinterpret_cast<char *> (b) + bytes;
+    held_ += bytes;
+    next_size_ = std::min (next_size_ * 2, max_size_);
+  }
+
+  void
+  pop_block () noexcept
+  {
+    block *b = head_;
+    head_ = b->prev;
+    held_ -= b->size;
+    upstream_->deallocate (b, b->size, alignof (std::max_align_t));
+  }
+
+private:
+  block *head_;
+  char *cur_;
+  char *end_;
+  size_type first_size_;
+  size_type next_size_;
+  size_type max_size_;
+  size_type used_;
+  size_type held_;
+  std::pmr::memory_resource *upstream_;
+};
+
+// lets pmr containers draw from an arena; deallocate is a no-op
+class arena_resource : public std::pmr::memory_resource
+{
+public:
+  explicit arena_resource (monotonic_arena &arena) noexcept : arena_ (arena)
+  {
+  }
+
+  monotonic_arena &
+  arena () const noexcept
+  {
+    return arena_;
+  }
+
+private:
+  void *
+  do_allocate (size_t bytes, size_t align) override
+  {
+    return arena_.allocate (bytes, align);
+  }
+
+  void
+  do_deallocate (void *, size_t, size_t) override
+  {
+  }
+
+  bool
+  do_is_equal (const std::pmr::memory_resource &other) const noexcept override
+  {
+    auto *r = dynamic_cast<const arena_resource *> (&other);
+    return r && &r->arena_ == &arena_;
+  }
+
+private:
+  monotonic_arena &arena_;
+};
+
+#endif // MONOTONIC_ARENA_H
@@ -0,0 +1,375 @@
+#ifndef MPMC_RING_BUFFER_H
+#define MPMC_RING_BUFFER_H
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <memory_resource>
+#include <condition_variable>
+
+template <typename T, size_t Capacity, typename Alloc = std::allocator<T>>
+class mpmc_ring_buffer
+{
+  static_assert (Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+		 "Capacity must be a power of two.");
+
+  struct cell
+  {
+    std::atomic<size_t> seq;
+    alignas (T) unsigned char storage[sizeof (T)];
+  };
+
+  using alloc_type =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<cell>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+public:
+  using size_type = size_t;
+  using allocator_type = Alloc;
+
+  explicit mpmc_ring_buffer (const Alloc &alloc = Alloc ())
+      : buffer_ (nullptr), head_ (0), tail_ (0), alloc_ (alloc)
+  {
+    buffer_ = alloc_traits::allocate (alloc_, Capacity);
+    for (size_type i = 0; i < Capacity; i++)
+      {
+	::new (static_cast<void *> (buffer_ + i)) cell;
+	buffer_[i].seq.store (i, std::memory_order_relaxed);
+      }
+  }
+
+  ~mpmc_ring_buffer ()
+  {
+    size_type curr_head = head_.load (std::memory_order_relaxed);
+    size_type curr_tail = tail_.load (std::memory_order_relaxed);
+
+    for (; curr_tail != curr_head; curr_tail++)
+      element (buffer_[curr_tail & (Capacity - 1)])->~T ();
+
+    for (size_type i = 0; i < Capacity; i++)
+      buffer_[i].~cell ();
+    alloc_traits::deallocate (alloc_, buffer_, Capacity);
+  }
+
+  mpmc_ring_buffer (const mpmc_ring_buffer &) = delete;
+  mpmc_ring_buffer &operator= (const mpmc_ring_buffer &) = delete;
+
+  template <typename U>
+  bool
+  try_push (U &&item)
+  {
+    size_type pos = head_.load (std::memory_order_relaxed);
+    cell *c;
+
+    for (;;)
+      {
+	c = &buffer_[pos & (Capacity - 1)];
+	size_type seq = c->seq.load (std::memory_order_acquire);
+	auto diff = static_cast<std::intptr_t> (seq - pos);
+
+	if (diff == 0)
+	  {
+	    if (head_.compare_exchange_weak (pos, pos + 1,
+					     std::memory_order_relaxed))
+	      break;
+	  }
+	else if (diff < 0)
+	  return false;
+	else
+	  pos = head_.load (std::memory_order_relaxed);
+      }
+
+    ::new (static_cast<void *> (c->storage)) T (std::forward<U> (item));
+    c->seq.store (pos + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  bool
+  try_pop (T &elem)
+  {
+    size_type pos;
+    cell *c = claim_pop (pos);
+    if (!c)
+      return false;
+
+    elem = std::move (*element (*c));
+    release_pop (c, pos);
+
+    return true;
+  }
+
+  std::optional<T>
+  try_pop ()
+  {
+    size_type pos;
+    cell *c = claim_pop (pos);
+    if (!c)
+      return std::nullopt;
+
+    std::optional<T> elem (std::move (*element (*c)));
+    release_pop (c, pos);
+
+    return elem;
+  }
+
+  size_type
+  size () const
+  {
+    size_type curr_tail = tail_.load (std::memory_order_relaxed);
+    size_type curr_head = head_.load (std::memory_order_relaxed);
+
+    return curr_head > curr_tail ? curr_head - curr_tail : 0;
+  }
+
+  bool
+  is_full () const
+  {
+    return size () >= Capacity;
+  }
+
+  bool
+  is_empty () const
+  {
+    return size () == 0;
+  }
+
+private:
+  static T *
+  element (cell &c)
+  {
+    return std::launder (reinterpret_cast<T *> (c.storage));
+  }
+
+  cell *
+  claim_pop (size_type &pos)
+  {
+    pos = tail_.load (std::memory_order_relaxed);
+
+    for (;;)
+      {
+	cell *c = &buffer_[pos & (Capacity - 1)];
+	size_type seq = c->seq.load (std::memory_order_acquire);
+	auto diff = static_cast<std::intptr_t> (seq - (pos + 1));
+
+	if (diff == 0)
+	  {
+	    if (tail_.compare_exchange_weak (pos, pos + 1,
+					     std::memory_order_relaxed))
+	      return c;
+	  }
+	else if (diff < 0)
+	  return nullptr;
+	else
+	  pos = tail_.load (std::memory_order_relaxed);
+      }
+  }
+
+  void
+  release_pop (cell *c, size_type pos)
+  {
+    element (*c)->~T ();
+    c->seq.store (pos + Capacity, std::memory_order_release);
+  }
+
+private:
+  cell *buffer_;
+  unsigned char pad0_[64 - sizeof (buffer_)];
+  std::atomic<size_type> head_;
+  unsigned char pad1_[64 - sizeof (head_)];
+  std::atomic<size_type> tail_;
+  unsigned char pad2_[64 - sizeof (tail_)];
+  alloc_type alloc_;
+};
+
+template <typename T, size_t Capacity, typename Alloc = std::allocator<T>>
+class blocking_mpmc_queue
+{
+  using clock = std::chrono::steady_clock;
+
+public:
+  using element_type = T;
+  using size_type = size_t;
+  using allocator_type = Alloc;
+
+  explicit blocking_mpmc_queue (const Alloc &alloc = Alloc ())
+      : ring_ (alloc), closed_ (false), push_waiters_ (0), pop_waiters_ (0)
+  {
+  }
+
+  blocking_mpmc_queue (const blocking_mpmc_queue &) = delete;
+  blocking_mpmc_queue &operator= (const blocking_mpmc_queue &) = delete;
+
+  template <typename U>
+  bool
+  push (U &&elem)
+  {
+    return push_until (std::forward<U> (elem), nullptr);
+  }
+
+  template <typename U, typename Duration>
+  bool
+  try_push (U &&elem, const Duration &timeout)
+  {
+    auto deadline = clock::now () + timeout;
+    return push_until (std::forward<U> (elem), &deadline);
+  }
+
+  std::optional<T>
+  pop ()
+  {
+    return pop_until (nullptr);
+  }
+
+  template <typename Duration>
+  std::optional<T>
+  try_pop (const Duration &timeout)
+  {
+    auto deadline = clock::now () + timeout;
+    return pop_until (&deadline);
+  }
+
+  void
+  close ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      closed_.store (true, std::memory_order_release);
+    }
+    not_empty_cv_.notify_all ();
+    not_full_cv_.notify_all ();
+  }
+
+  size_type
+  size () const
+  {
+    return ring_.size ();
+  }
+
+  bool
+  empty () const
+  {
+    return ring_.is_empty ();
+  }
+
+  bool
+  is_closed () const
+  {
+    return closed_.load (std::memory_order_acquire);
+  }
+
+private:
+  template <typename U>
+  bool
+  push_until (U &&elem, const clock::time_point *deadline)
+  {
+    for (;;)
+      {
+	if (closed_.load (std::memory_order_acquire))
+	  return false;
+
+	if (ring_.try_push (std::forward<U> (elem)))
+	  {
+	    wake (pop_waiters_, not_empty_cv_);
+	    return true;
+	  }
+
+	if (!park (push_waiters_, not_full_cv_, deadline, [this] {
+	      return !ring_.is_full ()
+		     || closed_.load (std::memory_order_relaxed);
+	    }))
+	  return false;
+      }
+  }
+
+  std::optional<T>
+  pop_until (const clock::time_point *deadline)
+  {
+    for (;;)
+      {
+	auto elem = ring_.try_pop ();
+	if (elem)
+	  {
+	    wake (push_waiters_, not_full_cv_);
+	    return elem;
+	  }
+
+	if (closed_.load (std::memory_order_acquire))
+	  {
+	    elem = ring_.try_pop ();
+	    if (elem)
+	      wake (push_waiters_, not_full_cv_);
+	    return elem;
+	  }
+
+	if (!park (pop_waiters_, not_empty_cv_, deadline, [this] {
+	      return !ring_.is_empty ()
+		     || closed_.load (std::memory_order_relaxed);
+	    }))
+	  return std::nullopt;
+      }
+  }
+
+  template <typename Pred>
+  bool
+  park (std::atomic<size_type> &waiters, std::condition_variable &cv,
+	const clock::time_point *deadline, Pred pred)
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    waiters.fetch_add (1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+
+    bool ready;
+    if (deadline)
+      ready = cv.wait_until (lock, *deadline, pred);
+    else
+      {
+	cv.wait (lock, pred);
+	ready = true;
+      }
+
+    waiters.fetch_sub (1, std::memory_order_relaxed);
+    return ready;
+  }
+
+  void
+  wake (std::atomic<size_type> &waiters, std::condition_variable &cv)
+  {
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+    if (waiters.load (std::memory_order_relaxed) == 0)
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+    }
+    cv.notify_one ();
+  }
+
+private:
+  mpmc_ring_buffer<T, Capacity, Alloc> ring_;
+
+  std::mutex mutex_;
+  std::atomic<bool> closed_;
+  std::atomic<size_type> push_waiters_;
+  std::atomic<size_type> pop_waiters_;
+  std::condition_variable not_full_cv_;
+  std::condition_variable not_empty_cv_;
+};
+
+namespace pmr
+{
+template <typename T, size_t Capacity>
+using mpmc_ring_buffer
+    = ::mpmc_ring_buffer<T, Capacity, std::pmr::polymorphic_allocator<T>>;
+
+template <typename T, size_t Capacity>
+using blocking_mpmc_queue
+    = ::blocking_mpmc_queue<T, Capacity, std::pmr::polymorphic_allocator<T>>;
+}
+
+#endif // MPMC_RING_BUFFER_H
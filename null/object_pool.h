@@ -0,0 +1,285 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <memory_resource>
+
+#include "unique_ptr.h"
+#include "reclamation.h"
+
+template <typename T>
+class object_pool;
+
+template <typename T>
+class pool_deleter
+{
+public:
+  pool_deleter () noexcept : pool_ (nullptr) {}
+  explicit pool_deleter (object_pool<T> *pool) noexcept : pool_ (pool) {}
+
+  void
+  operator() (T *ptr) const
+  {
+    pool_->release (ptr);
+  }
+
+private:
+  object_pool<T> *pool_;
+};
+
+struct object_pool_stats
+{
+  std::uint64_t acquires;
+  std::uint64_t hits;
+  std::uint64_t misses;
+  size_t in_use;
+  size_t held_bytes;
+  size_t idle_bytes;
+
+  double
+  hit_rate () const
+  {
+    return acquires ? static_cast<double> (hits) / acquires : 0.0;
+  }
+};
+
+// recycles storage for T through per-thread magazines backed by a shared
+// depot of full and empty magazines; the pool must outlive its objects.
+// Slots come from upstream, which must be thread-safe: a
+// synchronized_pool_resource over huge_page_resource packs them into
+// huge pages.
+template <typename T>
+class object_pool
+{
+  friend class pool_deleter<T>;
+
+  using magazine = std::vector<void *>;
+
+  // counters are written by the owning thread only
+  struct record : public thread_record
+  {
+    magazine loaded;
+    magazine previous;
+    std::atomic<std::uint64_t> acquires{ 0 };
+    std::atomic<std::uint64_t> releases{ 0 };
+    std::atomic<std::uint64_t> hits{ 0 };
+  };
+
+public:
+  using size_type = size_t;
+  using pointer = unique_ptr<T, pool_deleter<T>>;
+
+  explicit object_pool (
+      size_type magazine_size = 32, size_type depot_limit = 64,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource ())
+      : magazine_size_ (magazine_size ? magazine_size : 1),
+	depot_limit_ (depot_limit), upstream_ (upstream), held_ (0),
+	retired_{}
+  {
+  }
+
+  ~object_pool ()
+  {
+    registry_.for_each ([this] (record &r) {
+      free_magazine (r.loaded);
+      free_magazine (r.previous);
+    });
+    for (auto &m : full_)
+      free_magazine (m);
+  }
+
+  object_pool (const object_pool &) = delete;
+  object_pool &operator= (const object_pool &) = delete;
+
+  template <typename... Args>
+  pointer
+  acquire (Args &&...args)
+  {
+    record &rec = registry_.local ();
+    bump (rec.acquires);
+
+    void *slot = pop (rec);
+    try
+      {
+	T *obj = ::new (slot) T (std::forward<Args> (args)...);
+	return pointer (obj, pool_deleter<T> (this));
+      }
+    catch (...)
+      {
+	bump (rec.releases);
+	push (rec, slot);
+	throw;
+      }
+  }
+
+  object_pool_stats
+  stats ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    object_pool_stats s = retired_;
+
+    std::uint64_t releases = retired_releases_;
+    registry_.for_each ([&s, &releases] (record &r) {
+      s.acquires += r.acquires.load (std::memory_order_relaxed);
+      s.hits += r.hits.load (std::memory_order_relaxed);
+      releases += r.releases.load (std::memory_order_relaxed);
+    });
+
+    size_t held = held_.load (std::memory_order_relaxed);
+    s.misses = s.acquires - s.hits;
+    s.in_use = static_cast<size_t> (s.acquires - releases);
+    s.held_bytes = held * sizeof (T);
+    s.idle_bytes = held > s.in_use ? (held - s.in_use) * sizeof (T) : 0;
+    return s;
+  }
+
+private:
+  static void
+  bump (std::atomic<std::uint64_t> &counter)
+  {
+    counter.store (counter.load (std::memory_order_relaxed) + 1,
+		   std::memory_order_relaxed);
+  }
+
+  void
+  release (T *ptr)
+  {
+    ptr->~T ();
+
+    record &rec = registry_.local ();
+    bump (rec.releases);
+    push (rec, ptr);
+  }
+
+  void *
+  pop (record &rec)
+  {
+    if (rec.loaded.empty ())
+      {
+	if (!rec.previous.empty ())
+	  rec.loaded.swap (rec.previous);
+	else if (!refill (rec))
+	  return allocate_slot ();
+      }
+
+    bump (rec.hits);
+    void *slot = rec.loaded.back ();
+    rec.loaded.pop_back ();
+    return slot;
+  }
+
+  void
+  push (record &rec, void *slot)
+  {
+    if (rec.loaded.size () >= magazine_size_)
+      {
+	if (rec.previous.size () < magazine_size_)
+	  rec.loaded.swap (rec.previous);
+	else
+	  spill (rec);
+      }
+
+    rec.loaded.push_back (slot);
+  }
+
+  // trades the empty loaded magazine for a full one from the depot
+  bool
+  refill (record &rec)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    adopt_orphans ();
+    if (full_.empty ())
+      return false;
+
+    if (empty_.size () < depot_limit_)
+      empty_.push_back (std::move (rec.loaded));
+    rec.loaded = std::move (full_.back ());
+    full_.pop_back ();
+    return true;
+  }
+
+  // hands the full previous magazine to the depot, or frees it when the
+  // depot is at its limit
+  void
+  spill (record &rec)
+  {
+    magazine m = std::move (rec.previous);
+    rec.previous = std::move (rec.loaded);
+    rec.loaded = magazine ();
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      adopt_orphans ();
+      if (full_.size () < depot_limit_)
+	full_.push_back (std::exchange (m, magazine ()));
+      if (!empty_.empty ())
+	{
+	  rec.loaded = std::move (empty_.back ());
+	  empty_.pop_back ();
+	}
+    }
+
+    free_magazine (m);
+    rec.loaded.reserve (magazine_size_);
+  }
+
+  // folds the records of exited threads into the depot and totals
+  void
+  adopt_orphans ()
+  {
+    registry_.collect ([this] (record &r) {
+      retired_.acquires += r.acquires.load (std::memory_order_relaxed);
+      retired_.hits += r.hits.load (std::memory_order_relaxed);
+      retired_releases_ += r.releases.load (std::memory_order_relaxed);
+
+      for (magazine *m : { &r.loaded, &r.previous })
+	{
+	  if (!m->empty () && full_.size () < depot_limit_)
+	    full_.push_back (std::exchange (*m, magazine ()));
+	  free_magazine (*m);
+	}
+    });
+  }
+
+  void *
+  allocate_slot ()
+  {
+    void *slot = upstream_->allocate (sizeof (T), alignof (T));
+    held_.fetch_add (1, std::memory_order_relaxed);
+    return slot;
+  }
+
+  void
+  free_slot (void *slot) noexcept
+  {
+    held_.fetch_sub (1, std::memory_order_relaxed);
+    upstream_->deallocate (slot, sizeof (T), alignof (T));
+  }
+
+  void
+  free_magazine (magazine &m) noexcept
+  {
+    for (void *slot : m)
+      free_slot (slot);
+    m.clear ();
+  }
+
+private:
+  size_type magazine_size_;
+  size_type depot_limit_;
+  std::pmr::memory_resource *upstream_;
+  std::atomic<size_t> held_;
+  thread_registry<record> registry_;
+
+  std::mutex mutex_;
+  std::vector<magazine> full_;
+  std::vector<magazine> empty_;
+  object_pool_stats retired_;
+  std::uint64_t retired_releases_ = 0;
+};
+
+#endif // OBJECT_POOL_H
@@ -0,0 +1,244 @@
+#ifndef PRIORITY_BLOCKING_QUEUE_H
+#define PRIORITY_BLOCKING_QUEUE_H
+
+#include <mutex>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <utility>
+#include <optional>
+#include <algorithm>
+
+#include "circular_buffer.h"
+#include "counted_condition.h"
+
+template <typename T, size_t Lanes = 4, typename Alloc = std::allocator<T>>
+class priority_blocking_queue
+{
+  static_assert (Lanes > 0, "at least one lane is required");
+
+public:
+  using element_type = T;
+  using size_type = size_t;
+  using allocator_type = Alloc;
+  using clock = std::chrono::steady_clock;
+
+  static constexpr size_type lanes = Lanes;
+  static constexpr size_type lowest = Lanes - 1;
+
+private:
+  struct entry
+  {
+    T elem;
+    clock::time_point deadline;
+  };
+
+public:
+  explicit priority_blocking_queue (
+      size_type capacity = std::numeric_limits<size_type>::max (),
+      const Alloc &alloc = Alloc ())
+      : capacity_ (capacity), size_ (0), dropped_ (0),
+	lanes_ (make_lanes (alloc, std::make_index_sequence<Lanes> ())),
+	closed_ (false)
+  {
+  }
+
+  priority_blocking_queue (const priority_blocking_queue &) = delete;
+  priority_blocking_queue &operator= (const priority_blocking_queue &)
+      = delete;
+
+  template <typename U>
+  bool
+  push (U &&elem, size_type lane = lowest,
+	clock::time_point deadline = clock::time_point::max ())
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    not_full_.wait (lock, [this] { return size_ < capacity_ || closed_; });
+
+    if (closed_)
+      return false;
+
+    enqueue (std::forward<U> (elem), lane, deadline);
+    return true;
+  }
+
+  template <typename U, typename Duration>
+  bool
+  try_push (U &&elem, const Duration &timeout, size_type lane = lowest,
+	    clock::time_point deadline = clock::time_point::max ())
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    bool success = not_full_.wait_for (
+	lock, timeout, [this] { return size_ < capacity_ || closed_; });
+
+    if (!success || closed_)
+      return false;
+
+    enqueue (std::forward<U> (elem), lane, deadline);
+    return true;
+  }
+
+  std::optional<T>
+  pop ()
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    for (;;)
+      {
+	not_empty_.wait (lock, [this] { return size_ != 0 || closed_; });
+
+	if (auto elem = dequeue ())
+	  return elem;
+
+	if (closed_)
+	  return std::nullopt;
+      }
+  }
+
+  std::optional<T>
+  try_pop ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return dequeue ();
+  }
+
+  template <typename Duration>
+  std::optional<T>
+  try_pop (const Duration &timeout)
+  {
+    auto until = clock::now () + timeout;
+    std::unique_lock<std::mutex> lock (mutex_);
+
+    for (;;)
+      {
+	bool success = not_empty_.wait_for (
+	    lock, until - clock::now (),
+	    [this] { return size_ != 0 || closed_; });
+
+	if (auto elem = dequeue ())
+	  return elem;
+
+	if (!success || closed_)
+	  return std::nullopt;
+      }
+  }
+
+  void
+  close ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all ();
+    not_full_.notify_all ();
+  }
+
+  size_type
+  size () const
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return size_;
+  }
+
+  bool
+  empty () const
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return size_ == 0;
+  }
+
+  bool
+  is_closed () const
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return closed_;
+  }
+
+  size_type
+  dropped () const
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return dropped_;
+  }
+
+private:
+  template <size_t... I>
+  static std::array<circular_buffer<entry, Alloc>, Lanes>
+  make_lanes (const Alloc &alloc, std::index_sequence<I...>)
+  {
+    return { { (static_cast<void> (I), circular_buffer<entry, Alloc> (
+					   alloc))... } };
+  }
+
+  template <typename U>
+  void
+  enqueue (U &&elem, size_type lane, clock::time_point deadline)
+  {
+    lanes_[std::min (lane, lowest)].emplace_back (
+	entry{ std::forward<U> (elem), deadline });
+    size_++;
+    not_empty_.notify (1);
+  }
+
+  // takes the front of the highest non-empty lane, dropping expired items
+  std::optional<T>
+  dequeue ()
+  {
+    std::optional<T> elem;
+    size_type freed = 0;
+    auto now = clock::time_point::min ();
+
+    for (auto &lane : lanes_)
+      {
+	while (!lane.empty ())
+	  {
+	    entry &e = lane.front ();
+	    if (e.deadline != clock::time_point::max ())
+	      {
+		if (now == clock::time_point::min ())
+		  now = clock::now ();
+		if (e.deadline < now)
+		  {
+		    lane.pop_front ();
+		    dropped_++;
+		    freed++;
+		    continue;
+		  }
+	      }
+
+	    elem.emplace (std::move (e.elem));
+	    lane.pop_front ();
+	    freed++;
+	    break;
+	  }
+
+	if (elem)
+	  break;
+      }
+
+    size_ -= freed;
+    not_full_.notify (freed);
+
+    return elem;
+  }
+
+private:
+  size_type capacity_;
+  size_type size_;
+  size_type dropped_;
+  std::array<circular_buffer<entry, Alloc>, Lanes> lanes_;
+  mutable std::mutex mutex_;
+
+  bool closed_;
+  counted_condition not_full_;
+  counted_condition not_empty_;
+};
+
+namespace pmr
+{
+template <typename T, size_t Lanes = 4>
+using priority_blocking_queue
+    = ::priority_blocking_queue<T, Lanes, std::pmr::polymorphic_allocator<T>>;
+}
+
+#endif // PRIORITY_BLOCKING_QUEUE_H
@@ -0,0 +1,146 @@
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct null_queue_stats
+{
+  static constexpr bool enabled = false;
+
+  void record_push (size_t) noexcept {}
+  void record_pop (std::chrono::nanoseconds) noexcept {}
+  void record_push_wait (std::chrono::nanoseconds) noexcept {}
+  void record_pop_wait (std::chrono::nanoseconds) noexcept {}
+  void record_push_timeout () noexcept {}
+  void record_pop_timeout () noexcept {}
+};
+
+class queue_stats
+{
+public:
+  static constexpr bool enabled = true;
+  static constexpr size_t buckets = 40;
+
+  struct snapshot
+  {
+    std::uint64_t pushes;
+    std::uint64_t pops;
+    std::uint64_t high_water;
+    std::uint64_t push_waits;
+    std::uint64_t pop_waits;
+    std::chrono::nanoseconds push_wait_time;
+    std::chrono::nanoseconds pop_wait_time;
+    std::uint64_t push_timeouts;
+    std::uint64_t pop_timeouts;
+    // sojourn[i] counts items that waited in [2^(i-1), 2^i) ns
+    std::array<std::uint64_t, buckets> sojourn;
+  };
+
+  queue_stats () noexcept
+      : pushes_ (0), pops_ (0), high_water_ (0), push_waits_ (0),
+	pop_waits_ (0), push_wait_ns_ (0), pop_wait_ns_ (0),
+	push_timeouts_ (0), pop_timeouts_ (0)
+  {
+    for (auto &b : sojourn_)
+      b.store (0, std::memory_order_relaxed);
+  }
+
+  queue_stats (const queue_stats &) = delete;
+  queue_stats &operator= (const queue_stats &) = delete;
+
+  void
+  record_push (size_t depth) noexcept
+  {
+    bump (pushes_);
+    if (depth > high_water_.load (std::memory_order_relaxed))
+      high_water_.store (depth, std::memory_order_relaxed);
+  }
+
+  void
+  record_pop (std::chrono::nanoseconds sojourn) noexcept
+  {
+    bump (pops_);
+    bump (sojourn_[bucket (sojourn)]);
+  }
+
+  void
+  record_push_wait (std::chrono::nanoseconds d) noexcept
+  {
+    bump (push_waits_);
+    bump (push_wait_ns_, d.count ());
+  }
+
+  void
+  record_pop_wait (std::chrono::nanoseconds d) noexcept
+  {
+    bump (pop_waits_);
+    bump (pop_wait_ns_, d.count ());
+  }
+
+  void
+  record_push_timeout () noexcept
+  {
+    bump (push_timeouts_);
+  }
+
+  void
+  record_pop_timeout () noexcept
+  {
+    bump (pop_timeouts_);
+  }
+
+  snapshot
+  read () const noexcept
+  {
+    snapshot s;
+    s.pushes = pushes_.load (std::memory_order_relaxed);
+    s.pops = pops_.load (std::memory_order_relaxed);
+    s.high_water = high_water_.load (std::memory_order_relaxed);
+    s.push_waits = push_waits_.load (std::memory_order_relaxed);
+    s.pop_waits = pop_waits_.load (std::memory_order_relaxed);
+    s.push_wait_time = std::chrono::nanoseconds (
+	push_wait_ns_.load (std::memory_order_relaxed));
+    s.pop_wait_time = std::chrono::nanoseconds (
+	pop_wait_ns_.load (std::memory_order_relaxed));
+    s.push_timeouts = push_timeouts_.load (std::memory_order_relaxed);
+    s.pop_timeouts = pop_timeouts_.load (std::memory_order_relaxed);
+    for (size_t i = 0; i < buckets; i++)
+      s.sojourn[i] = sojourn_[i].load (std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  // the owning queue calls the recorders under its lock, so a plain
+  // load/store is enough; readers only need untorn values
+  static void
+  bump (std::atomic<std::uint64_t> &counter, std::uint64_t n = 1) noexcept
+  {
+    counter.store (counter.load (std::memory_order_relaxed) + n,
+		   std::memory_order_relaxed);
+  }
+
+  static size_t
+  bucket (std::chrono::nanoseconds d) noexcept
+  {
+    auto ns = static_cast<std::uint64_t> (d.count () > 0 ? d.count () : 0);
+    size_t i = ns ? 64 - __builtin_clzll (ns) : 0;
+    return i < buckets ? i : buckets - 1;
+  }
+
+private:
+  std::atomic<std::uint64_t> pushes_;
+  std::atomic<std::uint64_t> pops_;
+  std::atomic<std::uint64_t> high_water_;
+  std::atomic<std::uint64_t> push_waits_;
+  std::atomic<std::uint64_t> pop_waits_;
+  std::atomic<std::uint64_t> push_wait_ns_;
+  std::atomic<std::uint64_t> pop_wait_ns_;
+  std::atomic<std::uint64_t> push_timeouts_;
+  std::atomic<std::uint64_t> pop_timeouts_;
+  std::array<std::atomic<std::uint64_t>, buckets> sojourn_;
+};
+
+#endif // QUEUE_STATS_H
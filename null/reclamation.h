@@ -0,0 +1,148 @@
+#ifndef RECLAMATION_H
+#define RECLAMATION_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+struct retired_ptr
+{
+  void *ptr;
+  void (*reclaim) (void *);
+
+  void
+  operator() () const
+  {
+    reclaim (ptr);
+  }
+};
+
+template <typename T>
+retired_ptr
+make_retired (T *ptr)
+{
+  return { ptr, [] (void *p) { delete static_cast<T *> (p); } };
+}
+
+struct thread_record
+{
+  std::atomic<bool> active{ true };
+  std::atomic<bool> orphaned{ false };
+};
+
+// hands every thread one Record per domain; a record stays shared
+// between the domain and the thread so either may go away first
+template <typename Record>
+class thread_registry
+{
+  struct entry
+  {
+    std::uint64_t id;
+    std::shared_ptr<Record> record;
+  };
+
+  struct table
+  {
+    std::vector<entry> entries;
+
+    ~table ()
+    {
+      for (auto &e : entries)
+	e.record->active.store (false, std::memory_order_release);
+    }
+  };
+
+  struct cache
+  {
+    std::uint64_t id;
+    Record *record;
+  };
+
+public:
+  thread_registry () : id_ (next_id ()) {}
+
+  ~thread_registry ()
+  {
+    for (auto &r : records_)
+      r->orphaned.store (true, std::memory_order_release);
+  }
+
+  thread_registry (const thread_registry &) = delete;
+  thread_registry &operator= (const thread_registry &) = delete;
+
+  Record &
+  local ()
+  {
+    static thread_local cache last{ 0, nullptr };
+    if (last.id == id_)
+      return *last.record;
+
+    static thread_local table t;
+    auto &entries = t.entries;
+    entries.erase (std::remove_if (entries.begin (), entries.end (),
+				   [] (const entry &e) {
+				     return e.record->orphaned.load (
+					 std::memory_order_acquire);
+				   }),
+		   entries.end ());
+
+    auto it = std::find_if (entries.begin (), entries.end (),
+			    [this] (const entry &e) { return e.id == id_; });
+    if (it == entries.end ())
+      {
+	auto rec = std::make_shared<Record> ();
+	{
+	  std::lock_guard<std::mutex> lock (mutex_);
+	  records_.push_back (rec);
+	}
+	entries.push_back ({ id_, std::move (rec) });
+	it = entries.end () - 1;
+      }
+
+    last = { id_, it->record.get () };
+    return *last.record;
+  }
+
+  template <typename F>
+  void
+  for_each (F f)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    for (auto &r : records_)
+      f (*r);
+  }
+
+  // passes the records of exited threads to f, then forgets them
+  template <typename F>
+  void
+  collect (F f)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    auto it = std::remove_if (records_.begin (), records_.end (),
+			      [&f] (const std::shared_ptr<Record> &r) {
+				if (r->active.load (std::memory_order_acquire))
+				  return false;
+				f (*r);
+				return true;
+			      });
+    records_.erase (it, records_.end ());
+  }
+
+private:
+  static std::uint64_t
+  next_id ()
+  {
+    static std::atomic<std::uint64_t> counter{ 0 };
+    return counter.fetch_add (1, std::memory_order_relaxed) + 1;
+  }
+
+private:
+  std::uint64_t id_;
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<Record>> records_;
+};
+
+#endif // RECLAMATION_H
@@ -1,126 +1,791 @@
 #ifndef SHARED_PTR_H
 #define SHARED_PTR_H
 
+#include <new>
+#include <mutex>
 #include <atomic>
+#include <memory>
 #include <cstddef>
+#include <cstdint>
 #include <utility>
+#include <functional>
 #include <type_traits>
 
-template <typename T>
-class default_delete
+#include "unique_ptr.h"
+
+// reference count policies for shared_ptr and weak_ptr; pointers with
+// different policies are distinct types and never convert into each other.
+// Int sets the counter width: atomic_refcount<std::int32_t> takes 8 bytes
+// off every control block. weak_policy counts the weak references, and
+// release () drops a strong one, calling release_last () on the block once
+// none are left.
+template <typename Int = long>
+struct atomic_refcount
+{
+  using count_type = std::atomic<Int>;
+  using weak_policy = atomic_refcount;
+
+  static void
+  increment (count_type &count) noexcept
+  {
+    count.fetch_add (1, std::memory_order_relaxed);
+  }
+
+  // fails once the count has dropped to zero
+  static bool
+  increment_if_nonzero (count_type &count) noexcept
+  {
+    Int n = count.load (std::memory_order_relaxed);
+    do
+      if (n == 0)
+	return false;
+    while (!count.compare_exchange_weak (n, n + 1, std::memory_order_acq_rel,
+					 std::memory_order_relaxed));
+    return true;
+  }
+
+  // true when the last reference went away
+  static bool
+  decrement (count_type &count) noexcept
+  {
+    return count.fetch_sub (1, std::memory_order_acq_rel) == 1;
+  }
+
+  template <typename Block>
+  static void
+  release (Block &block) noexcept
+  {
+    if (decrement (block.shared_count))
+      block.release_last ();
+  }
+
+  static long
+  load (const count_type &count) noexcept
+  {
+    return static_cast<long> (count.load (std::memory_order_relaxed));
+  }
+};
+
+// plain counters, for objects that never leave one thread
+template <typename Int = long>
+struct local_refcount
+{
+  using count_type = Int;
+  using weak_policy = local_refcount;
+
+  static void
+  increment (count_type &count) noexcept
+  {
+    count++;
+  }
+
+  static bool
+  increment_if_nonzero (count_type &count) noexcept
+  {
+    if (count == 0)
+      return false;
+
+    count++;
+    return true;
+  }
+
+  static bool
+  decrement (count_type &count) noexcept
+  {
+    return --count == 0;
+  }
+
+  template <typename Block>
+  static void
+  release (Block &block) noexcept
+  {
+    if (decrement (block.shared_count))
+      block.release_last ();
+  }
+
+  static long
+  load (const count_type &count) noexcept
+  {
+    return static_cast<long> (count);
+  }
+};
+
+template <typename Policy>
+struct control_block_base;
+
+template <typename Policy>
+struct control_block_ops
+{
+  void (*dispose) (control_block_base<Policy> *);
+  void (*destroy) (control_block_base<Policy> *);
+};
+
+template <typename T,
+	  bool = std::is_empty<T>::value && !std::is_final<T>::value>
+class ebo_storage
 {
 public:
-  default_delete () noexcept = default;
+  template <typename U>
+  explicit ebo_storage (U &&value) : value_ (std::forward<U> (value))
+  {
+  }
+
+  T &
+  stored () noexcept
+  {
+    return value_;
+  }
 
+private:
+  T value_;
+};
+
+template <typename T>
+class ebo_storage<T, true> : private T
+{
+public:
   template <typename U>
-  default_delete (const default_delete<U> &)
+  explicit ebo_storage (U &&value) : T (std::forward<U> (value))
   {
-    static_assert (std::is_convertible<U *, T *>::value,
-		   "U* must be convertible to T*");
   }
 
-  void
-  operator() (T *ptr) const
+  T &
+  stored () noexcept
   {
-    delete ptr;
+    return *this;
   }
 };
 
+template <typename Policy>
 struct control_block_base
 {
-  std::atomic<long> use_count;
-  std::atomic<long> weak_count;
+  using count_type = typename Policy::count_type;
+  using weak_policy = typename Policy::weak_policy;
+
+  const control_block_ops<Policy> *ops;
+  count_type shared_count;
+  typename weak_policy::count_type weak_count;
+
+  explicit control_block_base (const control_block_ops<Policy> *ops_)
+      : ops (ops_), shared_count (1), weak_count (1)
+  {
+  }
 
-  control_block_base () : use_count (1), weak_count (1) {}
+  control_block_base (const control_block_base &) = delete;
+  control_block_base &operator= (const control_block_base &) = delete;
+
+  void
+  dispose ()
+  {
+    ops->dispose (this);
+  }
+
+  void
+  destroy ()
+  {
+    ops->destroy (this);
+  }
 
   void
   inc_use_count ()
   {
-    use_count.fetch_add (1, std::memory_order_relaxed);
+    Policy::increment (shared_count);
   }
 
   void
   inc_weak_count ()
   {
-    weak_count.fetch_add (1, std::memory_order_relaxed);
+    weak_policy::increment (weak_count);
   }
 
   bool
   lock_use_count ()
   {
-    long count = use_count.load (std::memory_order_relaxed);
-    do
-      if (count == 0)
-	return false;
-    while (!use_count.compare_exchange_weak (count, count + 1,
-					     std::memory_order_acq_rel,
-					     std::memory_order_relaxed));
-    return true;
+    return Policy::increment_if_nonzero (shared_count);
   }
 
   void
   dec_use_count ()
   {
-    if (use_count.fetch_sub (1, std::memory_order_acq_rel) == 1)
-      {
-	dispose ();
-	dec_weak_count ();
-      }
+    Policy::release (*this);
+  }
+
+  // the strong references together hold one weak reference
+  void
+  release_last ()
+  {
+    dispose ();
+    dec_weak_count ();
   }
 
   void
   dec_weak_count ()
   {
-    if (weak_count.fetch_sub (1, std::memory_order_acq_rel) == 1)
+    if (weak_policy::decrement (weak_count))
       destroy ();
   }
 
-  virtual ~control_block_base () = default;
-  virtual void dispose () = 0;
-  virtual void destroy () = 0;
+  long
+  use_count () const noexcept
+  {
+    return Policy::load (shared_count);
+  }
+};
+
+// biased reference counting: the thread that creates a block (its owner)
+// counts in biased with plain loads and stores, every other thread in the
+// shared word, which holds (count << 2) | flags. While the block is
+// unmerged the strong count is biased + shared; a merge folds biased into
+// shared, and from then on every thread counts there.
+//
+// The owner merges when its own count drops to zero. A non-owner release
+// that takes shared below zero may have dropped the last reference, which
+// only the owner can tell, so it queues the block on the owner's record.
+// The owner merges queued blocks when it next makes a block, when it calls
+// drain () and when it exits; a thread that hands objects to others and
+// then idles should call drain (). Once the owner has exited its biased
+// count is frozen, and a non-owner merges the block itself.
+template <typename Int = long>
+struct biased_refcount
+{
+  using weak_policy = atomic_refcount<Int>;
+  using block_type = control_block_base<biased_refcount>;
+
+  static constexpr Int merged = 1;
+  static constexpr Int queued = 2;
+  static constexpr Int one = 4;
+
+  class owner_record;
+
+  struct count_type
+  {
+    explicit count_type (Int n) noexcept
+	: owner (owner_record::local ()), biased (owner ? n : 0),
+	  shared (owner ? 0 : n * one | merged), next (nullptr)
+    {
+      if (!owner)
+	return;
+
+      owner->ref ();
+      if (owner->pending ())
+	owner->drain ();
+    }
+
+    ~count_type ()
+    {
+      if (owner)
+	owner->unref ();
+    }
+
+    owner_record *owner;
+    std::atomic<Int> biased;
+    std::atomic<Int> shared;
+    block_type *next;
+  };
+
+  class owner_record
+  {
+  public:
+    // null once the calling thread's record is gone, so blocks made by
+    // late thread_local destructors start out merged
+    static owner_record *
+    local () noexcept
+    {
+      if (!current && !gone)
+	holder ();
+      return current;
+    }
+
+    void
+    ref () noexcept
+    {
+      refs_.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    void
+    unref () noexcept
+    {
+      if (refs_.fetch_sub (1, std::memory_order_acq_rel) == 1)
+	delete this;
+    }
+
+    bool
+    pending () const noexcept
+    {
+      return pending_.load (std::memory_order_relaxed);
+    }
+
+    // false once the owner has exited
+    bool
+    enqueue (block_type *block) noexcept
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      if (exited_)
+	return false;
+
+      block->shared_count.next = head_;
+      head_ = block;
+      pending_.store (true, std::memory_order_relaxed);
+      return true;
+    }
+
+    // owner only
+    void
+    drain () noexcept
+    {
+      block_type *list;
+      {
+	std::lock_guard<std::mutex> lock (mutex_);
+	list = std::exchange (head_, nullptr);
+	pending_.store (false, std::memory_order_relaxed);
+      }
+
+      while (list)
+	{
+	  block_type *block = std::exchange (list, list->shared_count.next);
+	  count_type &c = block->shared_count;
+	  if (merge (c, c.biased.load (std::memory_order_relaxed)))
+	    block->release_last ();
+	  block->dec_weak_count ();
+	}
+    }
+
+    static inline thread_local owner_record *current = nullptr;
+
+  private:
+    owner_record () : refs_ (1), pending_ (false), head_ (nullptr) {}
+
+    struct holder_type
+    {
+      holder_type () : record (new (std::nothrow) owner_record ())
+      {
+	current = record;
+      }
+
+      // objects freed by the last drain may drop references to blocks
+      // this thread made; those now take the non-owner path
+      ~holder_type ()
+      {
+	current = nullptr;
+	gone = true;
+	if (!record)
+	  return;
+
+	{
+	  std::lock_guard<std::mutex> lock (record->mutex_);
+	  record->exited_ = true;
+	}
+	record->drain ();
+	record->unref ();
+      }
+
+      owner_record *record;
+    };
+
+    static void
+    holder () noexcept
+    {
+      static thread_local holder_type h;
+    }
+
+    static inline thread_local bool gone = false;
+
+    std::atomic<long> refs_;
+    std::atomic<bool> pending_;
+    std::mutex mutex_;
+    block_type *head_;
+    bool exited_ = false;
+  };
+
+  static void
+  increment (count_type &c) noexcept
+  {
+    if (c.owner == owner_record::current)
+      {
+	Int n = c.biased.load (std::memory_order_relaxed);
+	if (n > 0)
+	  {
+	    c.biased.store (n + 1, std::memory_order_relaxed);
+	    return;
+	  }
+      }
+    c.shared.fetch_add (one, std::memory_order_relaxed);
+  }
+
+  // the new reference goes to shared, so the test against the total and
+  // the increment are one compare-exchange
+  static bool
+  increment_if_nonzero (count_type &c) noexcept
+  {
+    Int s = c.shared.load (std::memory_order_acquire);
+    for (;;)
+      {
+	Int total = s >> 2;
+	if (!(s & merged))
+	  total += c.biased.load (std::memory_order_acquire);
+	if (total <= 0)
+	  return false;
+
+	if (c.shared.compare_exchange_weak (s, s + one,
+					    std::memory_order_acq_rel,
+					    std::memory_order_acquire))
+	  return true;
+      }
+  }
+
+  static void
+  release (block_type &block) noexcept
+  {
+    count_type &c = block.shared_count;
+
+    if (c.owner == owner_record::current)
+      {
+	Int n = c.biased.load (std::memory_order_relaxed);
+	if (n > 1)
+	  {
+	    c.biased.store (n - 1, std::memory_order_relaxed);
+	    return;
+	  }
+	if (n == 1)
+	  {
+	    if (merge (c, 0))
+	      block.release_last ();
+	    return;
+	  }
+      }
+
+    Int s = c.shared.load (std::memory_order_acquire);
+    if (s & merged)
+      {
+	if ((c.shared.fetch_sub (one, std::memory_order_acq_rel) >> 2) == 1)
+	  block.release_last ();
+	return;
+      }
+
+    // the queue holds a weak reference, so the block outlives its entry
+    bool weak = false;
+    for (;;)
+      {
+	Int next = s - one;
+	bool enqueue = !(s & (merged | queued)) && (next >> 2) < 0;
+	if (enqueue)
+	  {
+	    next |= queued;
+	    if (!weak)
+	      block.inc_weak_count ();
+	    weak = true;
+	  }
+
+	if (c.shared.compare_exchange_weak (s, next,
+					    std::memory_order_acq_rel,
+					    std::memory_order_acquire))
+	  {
+	    if (enqueue)
+	      hand_to_owner (block);
+	    else
+	      {
+		if (weak)
+		  block.dec_weak_count ();
+		if ((s & merged) && (next >> 2) == 0)
+		  block.release_last ();
+	      }
+	    return;
+	  }
+      }
+  }
+
+  static long
+  load (const count_type &c) noexcept
+  {
+    Int s = c.shared.load (std::memory_order_relaxed);
+    Int total = s >> 2;
+    if (!(s & merged))
+      total += c.biased.load (std::memory_order_relaxed);
+    return total > 0 ? static_cast<long> (total) : 0;
+  }
+
+  // merges the blocks other threads queued on the calling thread
+  static void
+  drain () noexcept
+  {
+    if (owner_record *r = owner_record::current)
+      r->drain ();
+  }
+
+private:
+  // folds biased into shared; true when that leaves no reference
+  static bool
+  merge (count_type &c, Int biased) noexcept
+  {
+    Int s = c.shared.load (std::memory_order_acquire);
+    Int total;
+    do
+      {
+	if (s & merged)
+	  return false;
+	total = (s >> 2) + biased;
+      }
+    while (!c.shared.compare_exchange_weak (s, total * one | merged,
+					    std::memory_order_acq_rel,
+					    std::memory_order_acquire));
+
+    c.biased.store (0, std::memory_order_relaxed);
+    return total == 0;
+  }
+
+  // the owner's exit published its last biased count through the mutex
+  static void
+  hand_to_owner (block_type &block) noexcept
+  {
+    count_type &c = block.shared_count;
+    if (c.owner->enqueue (&block))
+      return;
+
+    if (merge (c, c.biased.load (std::memory_order_acquire)))
+      block.release_last ();
+    block.dec_weak_count ();
+  }
+};
+
+template <size_t Size>
+class control_block_cache
+{
+  struct node
+  {
+    node *next;
+  };
+
+  struct cache
+  {
+    node *head = nullptr;
+    size_t count = 0;
+
+    ~cache ()
+    {
+      while (head)
+	::operator delete (std::exchange (head, head->next));
+      destroyed = true;
+    }
+  };
+
+  static constexpr size_t max_cached = 64;
+
+public:
+  static void *
+  allocate ()
+  {
+    cache *c = local ();
+    if (!c || !c->head)
+      return ::operator new (Size);
+
+    c->count--;
+    return std::exchange (c->head, c->head->next);
+  }
+
+  static void
+  deallocate (void *ptr) noexcept
+  {
+    cache *c = local ();
+    if (!c || c->count == max_cached)
+      return ::operator delete (ptr);
+
+    c->count++;
+    c->head = ::new (ptr) node{ c->head };
+  }
+
+private:
+  // blocks released by other thread_local destructors after the cache
+  // itself is gone go straight back to the global heap
+  static cache *
+  local () noexcept
+  {
+    if (destroyed)
+      return nullptr;
+
+    static thread_local cache c;
+    return &c;
+  }
+
+  static inline thread_local bool destroyed = false;
 };
 
-template <typename U, typename Deleter>
-struct control_block : public control_block_base
+template <typename U, typename Deleter, typename Policy>
+struct control_block : public control_block_base<Policy>,
+		       private ebo_storage<Deleter>
 {
+  using base_type = control_block_base<Policy>;
+
   U *ptr;
-  Deleter del;
 
-  control_block (U *ptr_, Deleter del_) : ptr (ptr_), del (std::move (del_)) {}
+  control_block (U *ptr_, Deleter del_)
+      : base_type (&table), ebo_storage<Deleter> (std::move (del_)),
+	ptr (ptr_)
+  {
+  }
 
-  ~control_block () override = default;
+  static void *
+  operator new (size_t size)
+  {
+    if constexpr (alignof (control_block) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      return ::operator new (size, std::align_val_t (alignof (control_block)));
+    else
+      return control_block_cache<sizeof (control_block)>::allocate ();
+  }
 
-  void
-  dispose () override
+  static void
+  operator delete (void *ptr) noexcept
   {
-    del (ptr);
+    if constexpr (alignof (control_block) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      ::operator delete (ptr, std::align_val_t (alignof (control_block)));
+    else
+      control_block_cache<sizeof (control_block)>::deallocate (ptr);
   }
 
-  void
-  destroy () override
+  static void
+  dispose_block (base_type *base)
+  {
+    auto *cb = static_cast<control_block *> (base);
+    cb->stored () (cb->ptr);
+  }
+
+  static void
+  destroy_block (base_type *base)
   {
-    delete this;
+    delete static_cast<control_block *> (base);
   }
+
+  static constexpr control_block_ops<Policy> table{ dispose_block,
+						    destroy_block };
 };
 
-template <typename T>
+template <typename U, typename Policy>
+struct inplace_control_block : public control_block_base<Policy>
+{
+  using base_type = control_block_base<Policy>;
+
+  typename std::aligned_storage<sizeof (U), alignof (U)>::type storage;
+
+  template <typename... Args>
+  explicit inplace_control_block (Args &&...args) : base_type (&table)
+  {
+    ::new (static_cast<void *> (&storage)) U (std::forward<Args> (args)...);
+  }
+
+  U *
+  get () noexcept
+  {
+    return std::launder (reinterpret_cast<U *> (&storage));
+  }
+
+  static void
+  dispose_block (base_type *base)
+  {
+    static_cast<inplace_control_block *> (base)->get ()->~U ();
+  }
+
+  static void
+  destroy_block (base_type *base)
+  {
+    delete static_cast<inplace_control_block *> (base);
+  }
+
+  static constexpr control_block_ops<Policy> table{ dispose_block,
+						    destroy_block };
+};
+
+template <typename U, typename Alloc, typename Policy>
+struct alloc_control_block
+    : public control_block_base<Policy>,
+      private ebo_storage<typename std::allocator_traits<Alloc>::
+			      template rebind_alloc<
+				  alloc_control_block<U, Alloc, Policy>>>
+{
+  using base_type = control_block_base<Policy>;
+  using alloc_type = typename std::allocator_traits<
+      Alloc>::template rebind_alloc<alloc_control_block>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+  using value_alloc_type =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<U>;
+  using value_alloc_traits = std::allocator_traits<value_alloc_type>;
+
+  typename std::aligned_storage<sizeof (U), alignof (U)>::type storage;
+
+  template <typename... Args>
+  explicit alloc_control_block (const Alloc &alloc_, Args &&...args)
+      : base_type (&table), ebo_storage<alloc_type> (alloc_type (alloc_))
+  {
+    value_alloc_type va (this->stored ());
+    value_alloc_traits::construct (va, raw (), std::forward<Args> (args)...);
+  }
+
+  U *
+  raw () noexcept
+  {
+    return reinterpret_cast<U *> (&storage);
+  }
+
+  U *
+  get () noexcept
+  {
+    return std::launder (raw ());
+  }
+
+  static void
+  dispose_block (base_type *base)
+  {
+    auto *cb = static_cast<alloc_control_block *> (base);
+    value_alloc_type va (cb->stored ());
+    value_alloc_traits::destroy (va, cb->get ());
+  }
+
+  static void
+  destroy_block (base_type *base)
+  {
+    auto *cb = static_cast<alloc_control_block *> (base);
+    alloc_type a (std::move (cb->stored ()));
+    cb->~alloc_control_block ();
+    alloc_traits::deallocate (a, cb, 1);
+  }
+
+  static constexpr control_block_ops<Policy> table{ dispose_block,
+						    destroy_block };
+};
+
+template <typename T, typename Policy = biased_refcount<>>
 class weak_ptr;
 
-template <typename T>
+template <typename T, typename Policy = biased_refcount<>>
 class shared_ptr;
 
-template <typename T>
+template <typename T, typename Policy = biased_refcount<>, typename... Args>
+shared_ptr<T, Policy> make_shared (Args &&...args);
+
+template <typename T, typename Policy = biased_refcount<>, typename Alloc,
+	  typename... Args>
+shared_ptr<T, Policy> allocate_shared (const Alloc &alloc, Args &&...args);
+
+template <typename T, typename Policy>
 class shared_ptr
 {
-  template <typename U>
+  template <typename U, typename P>
   friend class weak_ptr;
 
-  template <typename U>
+  template <typename U, typename P>
   friend class shared_ptr;
 
+  template <typename U, typename P, typename... Args>
+  friend shared_ptr<U, P> make_shared (Args &&...args);
+
+  template <typename U, typename P, typename Alloc, typename... Args>
+  friend shared_ptr<U, P> allocate_shared (const Alloc &alloc,
+					   Args &&...args);
+
+  using block_type = control_block_base<Policy>;
+
 public:
   using element_type = T;
-  using weak_type = weak_ptr<T>;
+  using policy_type = Policy;
+  using weak_type = weak_ptr<T, Policy>;
 
   shared_ptr (std::nullptr_t = nullptr) : ptr_ (nullptr), cb_ (nullptr) {}
 
@@ -133,7 +798,7 @@ public:
     try
       {
 	if (ptr)
-	  cb_ = new control_block<U, Deleter> (ptr, std::move (del));
+	  cb_ = new control_block<U, Deleter, Policy> (ptr, std::move (del));
       }
     catch (...)
       {
@@ -163,7 +828,7 @@ public:
   }
 
   template <typename U>
-  shared_ptr (const shared_ptr<U> &other) noexcept
+  shared_ptr (const shared_ptr<U, Policy> &other) noexcept
       : ptr_ (other.ptr_), cb_ (other.cb_)
   {
     static_assert (std::is_convertible<U *, T *>::value,
@@ -174,7 +839,7 @@ public:
 
   template <typename U>
   shared_ptr &
-  operator= (const shared_ptr<U> &other) noexcept
+  operator= (const shared_ptr<U, Policy> &other) noexcept
   {
     shared_ptr (other).swap (*this);
     return *this;
@@ -194,7 +859,7 @@ public:
   }
 
   template <typename U>
-  shared_ptr (shared_ptr<U> &&other) noexcept
+  shared_ptr (shared_ptr<U, Policy> &&other) noexcept
       : ptr_ (std::exchange (other.ptr_, nullptr)),
 	cb_ (std::exchange (other.cb_, nullptr))
   {
@@ -204,7 +869,7 @@ public:
 
   template <typename U>
   shared_ptr &
-  operator= (shared_ptr<U> &&other) noexcept
+  operator= (shared_ptr<U, Policy> &&other) noexcept
   {
     shared_ptr (std::move (other)).swap (*this);
     return *this;
@@ -252,12 +917,60 @@ public:
   long
   use_count () const noexcept
   {
-    return cb_ ? cb_->use_count.load (std::memory_order_relaxed) : 0;
+    return cb_ ? cb_->use_count () : 0;
+  }
+
+  // orders by control block, so two pointers are equivalent exactly when
+  // they share ownership
+  template <typename U>
+  bool
+  owner_before (const shared_ptr<U, Policy> &other) const noexcept
+  {
+    return std::less<block_type *> () (cb_, other.cb_);
   }
 
 private:
   T *ptr_;
-  control_block_base *cb_;
+  block_type *cb_;
 };
 
+template <typename T, typename Policy, typename... Args>
+shared_ptr<T, Policy>
+make_shared (Args &&...args)
+{
+  auto *cb
+      = new inplace_control_block<T, Policy> (std::forward<Args> (args)...);
+
+  shared_ptr<T, Policy> sp;
+  sp.ptr_ = cb->get ();
+  sp.cb_ = cb;
+  return sp;
+}
+
+template <typename T, typename Policy, typename Alloc, typename... Args>
+shared_ptr<T, Policy>
+allocate_shared (const Alloc &alloc, Args &&...args)
+{
+  using block_type = alloc_control_block<T, Alloc, Policy>;
+  using alloc_traits = typename block_type::alloc_traits;
+
+  typename block_type::alloc_type a (alloc);
+  block_type *cb = alloc_traits::allocate (a, 1);
+  try
+    {
+      ::new (static_cast<void *> (cb))
+	  block_type (alloc, std::forward<Args> (args)...);
+    }
+  catch (...)
+    {
+      alloc_traits::deallocate (a, cb, 1);
+      throw;
+    }
+
+  shared_ptr<T, Policy> sp;
+  sp.ptr_ = cb->get ();
+  sp.cb_ = cb;
+  return sp;
+}
+
 #endif // SHARED_PTR_H
@@ -0,0 +1,338 @@
+#ifndef SHM_SPSC_CHANNEL_H
+#define SHM_SPSC_CHANNEL_H
+
+#include <new>
+#include <atomic>
+#include <string>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class shm_spsc_channel
+{
+  static constexpr std::uint64_t magic = 0x6e756c6c73707363; // "nullspsc"
+  static constexpr std::uint32_t version = 1;
+
+  static_assert (std::atomic<std::uint64_t>::is_always_lock_free,
+		 "shared-memory indices must be lock-free");
+
+  struct header
+  {
+    std::atomic<std::uint64_t> magic;
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t capacity;
+
+    alignas (64) std::atomic<std::uint64_t> head;
+    alignas (64) std::atomic<std::uint64_t> tail;
+  };
+
+  struct alignas (8) record
+  {
+    std::uint32_t length;
+    std::uint32_t flags;
+  };
+
+  static constexpr std::uint32_t padding = 1;
+  static constexpr size_t data_offset = (sizeof (header) + 63) & ~size_t (63);
+
+public:
+  using size_type = size_t;
+
+  static shm_spsc_channel
+  create (const std::string &name, size_type capacity)
+  {
+    if (capacity < 64 || (capacity & (capacity - 1)) != 0)
+      throw std::invalid_argument ("capacity must be a power of two >= 64");
+
+    int fd = ::shm_open (name.c_str (), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+      throw std::system_error (errno, std::generic_category (), "shm_open");
+
+    size_type length = data_offset + capacity;
+    if (::ftruncate (fd, static_cast<off_t> (length)) < 0)
+      {
+	int err = errno;
+	::close (fd);
+	::shm_unlink (name.c_str ());
+	throw std::system_error (err, std::generic_category (), "ftruncate");
+      }
+
+    void *base;
+    try
+      {
+	base = map (fd, length);
+      }
+    catch (...)
+      {
+	::shm_unlink (name.c_str ());
+	throw;
+      }
+
+    shm_spsc_channel chan (base, length);
+    header *hdr = new (base) header ();
+    hdr->version = version;
+    hdr->header_size = static_cast<std::uint32_t> (data_offset);
+    hdr->capacity = capacity;
+    hdr->head.store (0, std::memory_order_relaxed);
+    hdr->tail.store (0, std::memory_order_relaxed);
+    hdr->magic.store (magic, std::memory_order_release);
+
+    chan.init (hdr);
+    return chan;
+  }
+
+  static shm_spsc_channel
+  attach (const std::string &name)
+  {
+    int fd = ::shm_open (name.c_str (), O_RDWR, 0);
+    if (fd < 0)
+      throw std::system_error (errno, std::generic_category (), "shm_open");
+
+    struct stat st;
+    if (::fstat (fd, &st) < 0)
+      {
+	int err = errno;
+	::close (fd);
+	throw std::system_error (err, std::generic_category (), "fstat");
+      }
+
+    auto length = static_cast<size_type> (st.st_size);
+    if (length < data_offset)
+      {
+	::close (fd);
+	throw std::runtime_error ("shared-memory channel is not initialized");
+      }
+
+    shm_spsc_channel chan (map (fd, length), length);
+    auto *hdr = static_cast<header *> (chan.base_);
+
+    if (hdr->magic.load (std::memory_order_acquire) != magic)
+      throw std::runtime_error ("shared-memory channel is not initialized");
+    if (hdr->version != version || hdr->header_size != data_offset)
+      throw std::runtime_error ("shared-memory channel version mismatch");
+    if (data_offset + hdr->capacity != length)
+      throw std::runtime_error ("shared-memory channel size mismatch");
+
+    chan.init (hdr);
+    return chan;
+  }
+
+  static void
+  remove (const std::string &name)
+  {
+    ::shm_unlink (name.c_str ());
+  }
+
+  ~shm_spsc_channel ()
+  {
+    if (base_)
+      ::munmap (base_, length_);
+  }
+
+  shm_spsc_channel (const shm_spsc_channel &) = delete;
+  shm_spsc_channel &operator= (const shm_spsc_channel &) = delete;
+
+  shm_spsc_channel (shm_spsc_channel &&other) noexcept
+      : base_ (std::exchange (other.base_, nullptr)),
+	length_ (std::exchange (other.length_, 0)), hdr_ (other.hdr_),
+	data_ (other.data_), mask_ (other.mask_),
+	head_cache_ (other.head_cache_), tail_cache_ (other.tail_cache_),
+	pending_ (other.pending_), read_pos_ (other.read_pos_)
+  {
+  }
+
+  shm_spsc_channel &
+  operator= (shm_spsc_channel &&other) noexcept
+  {
+    shm_spsc_channel (std::move (other)).swap (*this);
+    return *this;
+  }
+
+  void
+  swap (shm_spsc_channel &other) noexcept
+  {
+    using std::swap;
+    swap (base_, other.base_);
+    swap (length_, other.length_);
+    swap (hdr_, other.hdr_);
+    swap (data_, other.data_);
+    swap (mask_, other.mask_);
+    swap (head_cache_, other.head_cache_);
+    swap (tail_cache_, other.tail_cache_);
+    swap (pending_, other.pending_);
+    swap (read_pos_, other.read_pos_);
+  }
+
+  // producer side
+
+  void *
+  reserve (size_type len)
+  {
+    if (len > max_message_size ())
+      return nullptr;
+
+    size_type need = record_size (len);
+    std::uint64_t head = hdr_->head.load (std::memory_order_relaxed);
+    size_type room = capacity () - (head & mask_);
+    size_type pad = room < need ? room : 0;
+
+    if (head + pad + need - tail_cache_ > capacity ())
+      {
+	tail_cache_ = hdr_->tail.load (std::memory_order_acquire);
+	if (head + pad + need - tail_cache_ > capacity ())
+	  return nullptr;
+      }
+
+    if (pad)
+      {
+	record rec{ static_cast<std::uint32_t> (pad - sizeof (record)),
+		    padding };
+	std::memcpy (data_ + (head & mask_), &rec, sizeof (rec));
+      }
+
+    pending_ = head + pad;
+    return data_ + (pending_ & mask_) + sizeof (record);
+  }
+
+  void
+  commit (size_type len)
+  {
+    record rec{ static_cast<std::uint32_t> (len), 0 };
+    std::memcpy (data_ + (pending_ & mask_), &rec, sizeof (rec));
+    hdr_->head.store (pending_ + record_size (len), std::memory_order_release);
+  }
+
+  bool
+  push (const void *data, size_type len)
+  {
+    void *buf = reserve (len);
+    if (!buf)
+      return false;
+
+    std::memcpy (buf, data, len);
+    commit (len);
+
+    return true;
+  }
+
+  // consumer side
+
+  const void *
+  front (size_type &len)
+  {
+    for (;;)
+      {
+	std::uint64_t tail = hdr_->tail.load (std::memory_order_relaxed);
+	if (tail == head_cache_)
+	  {
+	    head_cache_ = hdr_->head.load (std::memory_order_acquire);
+	    if (tail == head_cache_)
+	      return nullptr;
+	  }
+
+	record rec;
+	std::memcpy (&rec, data_ + (tail & mask_), sizeof (rec));
+
+	if (rec.flags & padding)
+	  {
+	    hdr_->tail.store (tail + sizeof (record) + rec.length,
+			      std::memory_order_release);
+	    continue;
+	  }
+
+	read_pos_ = tail;
+	len = rec.length;
+	return data_ + (tail & mask_) + sizeof (record);
+      }
+  }
+
+  void
+  pop ()
+  {
+    record rec;
+    std::memcpy (&rec, data_ + (read_pos_ & mask_), sizeof (rec));
+    hdr_->tail.store (read_pos_ + record_size (rec.length),
+		      std::memory_order_release);
+  }
+
+  size_type
+  capacity () const
+  {
+    return mask_ + 1;
+  }
+
+  size_type
+  max_message_size () const
+  {
+    return capacity () / 2 - sizeof (record);
+  }
+
+  bool
+  is_empty () const
+  {
+    return hdr_->head.load (std::memory_order_relaxed)
+	   == hdr_->tail.load (std::memory_order_relaxed);
+  }
+
+private:
+  shm_spsc_channel (void *base, size_type length)
+      : base_ (base), length_ (length), hdr_ (nullptr), data_ (nullptr),
+	mask_ (0), head_cache_ (0), tail_cache_ (0), pending_ (0),
+	read_pos_ (0)
+  {
+  }
+
+  static void *
+  map (int fd, size_type length)
+  {
+    void *base
+	= ::mmap (nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close (fd);
+
+    if (base == MAP_FAILED)
+      throw std::system_error (err, std::generic_category (), "mmap");
+    return base;
+  }
+
+  void
+  init (header *hdr)
+  {
+    hdr_ = hdr;
+    data_ = static_cast<unsigned char *> (base_) + data_offset;
+    mask_ = hdr->capacity - 1;
+    head_cache_ = hdr->head.load (std::memory_order_acquire);
+    tail_cache_ = hdr->tail.load (std::memory_order_acquire);
+  }
+
+  static size_type
+  record_size (size_type len)
+  {
+    return (sizeof (record) + len + alignof (record) - 1)
+	   & ~(alignof (record) - 1);
+  }
+
+private:
+  void *base_;
+  size_type length_;
+
+  header *hdr_;
+  unsigned char *data_;
+  size_type mask_;
+
+  std::uint64_t head_cache_;
+  std::uint64_t tail_cache_;
+  std::uint64_t pending_;
+  std::uint64_t read_pos_;
+};
+
+#endif // SHM_SPSC_CHANNEL_H
@@ -4,18 +4,38 @@
 #include <new>
 #include <atomic>
 #include <memory>
+#include <memory_resource>
 
-template <typename T, size_t Capacity>
+template <typename T, size_t Capacity, typename Alloc = std::allocator<T>>
 class spsc_ring_buffer
 {
+  using alloc_type =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
 public:
   using size_type = size_t;
+  using allocator_type = alloc_type;
 
-  spsc_ring_buffer ()
-      : head_ (0), tail_ (0), buffer_ (std::make_unique<T[]> (Capacity + 1))
+  explicit spsc_ring_buffer (const alloc_type &alloc = alloc_type ())
+      : head_ (0), tail_ (0), alloc_ (alloc),
+	buffer_ (alloc_traits::allocate (alloc_, Capacity + 1))
   {
+    size_type i = 0;
+    try
+      {
+	for (; i < Capacity + 1; i++)
+	  alloc_traits::construct (alloc_, buffer_ + i);
+      }
+    catch (...)
+      {
+	destroy (i);
+	throw;
+      }
   }
 
+  ~spsc_ring_buffer () { destroy (Capacity + 1); }
+
   spsc_ring_buffer (const spsc_ring_buffer &) = delete;
   spsc_ring_buffer &operator= (const spsc_ring_buffer &) = delete;
 
@@ -75,12 +95,29 @@ public:
 	   == tail_.load (std::memory_order_relaxed);
   }
 
+private:
+  void
+  destroy (size_type n) noexcept
+  {
+    for (size_type i = 0; i < n; i++)
+      alloc_traits::destroy (alloc_, buffer_ + i);
+    alloc_traits::deallocate (alloc_, buffer_, Capacity + 1);
+  }
+
 private:
   std::atomic<size_type> head_;
   unsigned char pad_[64 - sizeof (head_)];
   std::atomic<size_type> tail_;
 
-  std::unique_ptr<T[]> buffer_;
+  alloc_type alloc_;
+  T *buffer_;
 };
 
+namespace pmr
+{
+template <typename T, size_t Capacity>
+using spsc_ring_buffer
+    = ::spsc_ring_buffer<T, Capacity, std::pmr::polymorphic_allocator<T>>;
+}
+
 #endif // SPSC_RING_BUFFER_H
@@ -0,0 +1,133 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+#include "atomic_shared_ptr.h"
+
+struct config
+{
+  static inline std::atomic<long> live{ 0 };
+
+  explicit config (long v) : version (v), check (~v) { live++; }
+  ~config ()
+  {
+    check = 0;
+    live--;
+  }
+
+  bool
+  valid () const
+  {
+    return check == ~version;
+  }
+
+  long version;
+  long check;
+};
+
+static void
+test_basic ()
+{
+  atomic_shared_ptr<config> a;
+  assert (!a.load ());
+
+  a.store (make_shared<config> (1));
+  assert (a.load ()->version == 1);
+
+  auto old = a.exchange (make_shared<config> (2));
+  assert (old->version == 1 && a.load ()->version == 2);
+
+  auto expected = a.load ();
+  assert (a.compare_exchange_strong (expected, make_shared<config> (3)));
+  assert (a.load ()->version == 3);
+
+  assert (!a.compare_exchange_strong (expected, make_shared<config> (4)));
+  assert (expected->version == 3);
+}
+
+// same get (), different control block: not equivalent, so the exchange
+// must fail and hand back the stored owner
+static void
+test_compare_ownership ()
+{
+  static config shared_object (7);
+  auto noop = [] (config *) {};
+
+  shared_ptr<config> stored (&shared_object, noop);
+  shared_ptr<config> other (&shared_object, noop);
+  assert (stored.get () == other.get ());
+
+  atomic_shared_ptr<config> a (stored);
+  shared_ptr<config> expected = other;
+  assert (!a.compare_exchange_strong (expected, make_shared<config> (8)));
+  assert (!expected.owner_before (stored) && !stored.owner_before (expected));
+  assert (a.load ().get () == &shared_object);
+}
+
+// readers check every snapshot is alive while writers store and bump the
+// version with compare_exchange; run under ASan to catch early frees
+static void
+test_stress ()
+{
+  constexpr int readers = 4, writers = 2, updaters = 2;
+  constexpr long rounds = 20000;
+  long before = config::live;
+
+  atomic_shared_ptr<config> a (make_shared<config> (0));
+  std::atomic<bool> done (false);
+  std::atomic<long> bumps (0);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < readers; i++)
+    threads.emplace_back ([&] {
+      while (!done)
+	{
+	  auto p = a.load ();
+	  assert (p && p->valid ());
+	}
+    });
+
+  for (int i = 0; i < writers; i++)
+    threads.emplace_back ([&] {
+      for (long r = 0; r < rounds; r++)
+	a.store (make_shared<config> (-r));
+    });
+
+  for (int i = 0; i < updaters; i++)
+    threads.emplace_back ([&] {
+      for (long r = 0; r < rounds; r++)
+	{
+	  auto expected = a.load ();
+	  auto next = make_shared<config> (expected->version + 1);
+	  while (!a.compare_exchange_weak (expected, next))
+	    next = make_shared<config> (expected->version + 1);
+	  assert (expected->valid ());
+	  bumps++;
+	}
+    });
+
+  for (size_t i = readers; i < threads.size (); i++)
+    threads[i].join ();
+  done = true;
+  for (int i = 0; i < readers; i++)
+    threads[static_cast<size_t> (i)].join ();
+
+  assert (bumps == updaters * rounds);
+  assert (a.load ()->valid ());
+  a.store ({});
+
+  // readers dropped the first config last; main owns it and merges it here
+  biased_refcount<>::drain ();
+  assert (config::live == before);
+}
+
+int
+main ()
+{
+  test_basic ();
+  test_compare_ownership ();
+  test_stress ();
+}
@@ -0,0 +1,83 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <iterator>
+
+#include "concurrent_blocking_queue.h"
+
+using namespace std::chrono_literals;
+
+static void
+test_pop_batch ()
+{
+  concurrent_blocking_queue<int> q;
+  std::vector<int> out;
+
+  for (int i = 0; i < 5; i++)
+    q.push (i);
+  assert (q.pop_batch (std::back_inserter (out), 3) == 3);
+  assert (q.pop_batch (std::back_inserter (out), 8, 1ms) == 2);
+  assert ((out == std::vector<int>{ 0, 1, 2, 3, 4 }));
+
+  q.close ();
+  assert (q.pop_batch (std::back_inserter (out), 8, 1ms) == 0);
+}
+
+// a try_pop thief drains the queue while pop_batch lingers; pop_batch
+// must keep waiting instead of reporting end of stream
+static void
+test_pop_batch_competing_consumer ()
+{
+  concurrent_blocking_queue<int> q;
+  constexpr long items = 20000;
+
+  std::atomic<bool> done (false);
+  std::atomic<long> stolen (0);
+  long batched = 0;
+
+  std::thread thief ([&] {
+    while (!done.load ())
+      if (q.try_pop ())
+	stolen++;
+  });
+
+  std::thread batcher ([&] {
+    std::vector<int> buf;
+    for (;;)
+      {
+	buf.clear ();
+	auto n = q.pop_batch (std::back_inserter (buf), 64, 100us);
+	if (n == 0)
+	  {
+	    assert (q.is_closed ());
+	    break;
+	  }
+	batched += static_cast<long> (n);
+      }
+  });
+
+  for (long i = 0; i < items; i++)
+    {
+      q.push (static_cast<int> (i));
+      if (i % 16 == 0)
+	std::this_thread::yield ();
+    }
+  q.close ();
+
+  batcher.join ();
+  done = true;
+  thief.join ();
+
+  assert (stolen + batched + static_cast<long> (q.size ()) == items);
+}
+
+int
+main ()
+{
+  test_pop_batch ();
+  test_pop_batch_competing_consumer ();
+}
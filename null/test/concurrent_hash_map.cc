@@ -0,0 +1,121 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+#include "concurrent_hash_map.h"
+
+static void
+test_basic ()
+{
+  concurrent_hash_map<std::string, std::string> map;
+
+  assert (map.insert (std::string ("a"), std::string ("1")));
+  assert (!map.insert (std::string ("a"), std::string ("2")));
+  assert (*map.find ("a") == "1");
+
+  assert (!map.insert_or_assign (std::string ("a"), std::string ("3")));
+  assert (*map.find ("a") == "3");
+  assert (map.size () == 1);
+
+  assert (map.erase ("a"));
+  assert (!map.erase ("a"));
+  assert (!map.find ("a"));
+  assert (map.empty ());
+}
+
+struct counted
+{
+  static inline std::atomic<int> copies{ 0 };
+
+  explicit counted (long v) : value (v) {}
+  counted (const counted &other) : value (other.value) { copies++; }
+  counted (counted &&other) noexcept : value (other.value) { copies++; }
+
+  long value;
+};
+
+// growing re-links entries, so values are never copied or moved
+static void
+test_resize_keeps_values ()
+{
+  concurrent_hash_map<long, counted> map (64);
+
+  for (long k = 0; k < 10000; k++)
+    map.insert (k, counted (k));
+
+  int built = counted::copies.load ();
+  for (long k = 10000; k < 20000; k++)
+    map.insert (k, counted (k));
+
+  assert (map.bucket_count () >= 16384);
+  assert (counted::copies.load () - built == 10000);
+
+  for (long k = 0; k < 20000; k++)
+    assert (map.contains (k));
+}
+
+// writers insert, overwrite and erase disjoint keys while the table
+// grows under them; readers only ever see a key's own values
+static void
+test_concurrent ()
+{
+  constexpr long keys = 40000;
+  constexpr int writers = 4;
+
+  concurrent_hash_map<long, long> map (16);
+  std::atomic<bool> stop{ false };
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; r++)
+    readers.emplace_back ([&] {
+      while (!stop.load ())
+	for (long k = 0; k < keys; k += 7)
+	  if (auto v = map.find (k))
+	    assert (*v == k || *v == -k);
+    });
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < writers; t++)
+    threads.emplace_back ([&, t] {
+      for (long k = t; k < keys; k += writers)
+	map.insert (k, k);
+      for (long k = t; k < keys; k += writers)
+	if (k % 2)
+	  map.insert_or_assign (k, -k);
+      for (long k = t; k < keys; k += writers)
+	if (k % 5 == 0)
+	  map.erase (k);
+    });
+
+  for (auto &t : threads)
+    t.join ();
+  stop.store (true);
+  for (auto &t : readers)
+    t.join ();
+
+  size_t present = 0;
+  for (long k = 0; k < keys; k++)
+    {
+      auto v = map.find (k);
+      if (k % 5 == 0)
+	assert (!v);
+      else
+	{
+	  assert (v && *v == (k % 2 ? -k : k));
+	  present++;
+	}
+    }
+  assert (present == map.size ());
+}
+
+int
+main ()
+{
+  test_basic ();
+  test_resize_keeps_values ();
+  test_concurrent ();
+}
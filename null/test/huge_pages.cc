@@ -0,0 +1,97 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "huge_pages.h"
+
+static size_t
+mapped_bytes ()
+{
+  auto &usage = huge_page_usage::global ();
+  return usage.hugetlb + usage.transparent + usage.normal;
+}
+
+static bool
+huge_aligned (const void *p)
+{
+  return reinterpret_cast<std::uintptr_t> (p) % huge_page_size () == 0;
+}
+
+// hugetlb or the trimmed THP fallback, either way the whole rounded
+// range must be aligned, writable, and accounted under its kind
+static void
+test_map_pages ()
+{
+  size_t huge = huge_page_size ();
+  page_mapping m = map_pages (huge + 1, any_node);
+
+  assert (huge_aligned (m.addr));
+  assert (m.size == 2 * huge);
+  assert (huge_page_usage::global ()[m.kind] == m.size);
+  if (m.kind == page_kind::hugetlb)
+    assert (m.page_size == huge);
+  else
+    assert (m.page_size == base_page_size ());
+
+  auto *bytes = static_cast<unsigned char *> (m.addr);
+  bytes[0] = 1;
+  bytes[m.size - 1] = 2;
+
+  unmap_pages (m);
+  assert (mapped_bytes () == 0);
+}
+
+static void
+test_resource ()
+{
+  huge_page_resource resource;
+  size_t huge = huge_page_size ();
+  auto &registry = page_registry::global ();
+
+  void *p = resource.allocate (huge, 64);
+  assert (huge_aligned (p));
+  assert (mapped_bytes () == huge);
+
+  size_t page = registry.page_size (p);
+  assert (page == huge || page == base_page_size ());
+  assert ((page == huge) == (huge_page_usage::global ().hugetlb == huge));
+  std::memset (p, 0xa5, huge);
+
+  resource.deallocate (p, huge, 64);
+  assert (mapped_bytes () == 0);
+  assert (registry.page_size (p) == 0);
+
+  // below the threshold: operator new, nothing mapped or registered
+  void *small = resource.allocate (64, 16);
+  assert (mapped_bytes () == 0);
+  assert (registry.page_size (small) == 0);
+  resource.deallocate (small, 64, 16);
+}
+
+// the threshold sits at half a huge page, on both sides of the call
+static void
+test_threshold ()
+{
+  huge_page_resource resource;
+  size_t half = huge_page_size () / 2;
+
+  void *below = resource.allocate (half - 1);
+  void *at = resource.allocate (half);
+  assert (page_registry::global ().page_size (below) == 0);
+  assert (page_registry::global ().page_size (at) != 0);
+  assert (mapped_bytes () == huge_page_size ());
+
+  resource.deallocate (at, half);
+  resource.deallocate (below, half - 1);
+  assert (mapped_bytes () == 0);
+}
+
+int
+main ()
+{
+  test_map_pages ();
+  test_resource ();
+  test_threshold ();
+}
@@ -0,0 +1,127 @@
+#undef NDEBUG
+
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "monotonic_arena.h"
+
+static bool
+aligned (const void *p, size_t align)
+{
+  return reinterpret_cast<std::uintptr_t> (p) % align == 0;
+}
+
+// remembers the blocks it hands out so a test can check that an
+// allocation lies inside one of them
+class tracking_resource : public std::pmr::memory_resource
+{
+public:
+  bool
+  contains (const void *ptr, size_t size) const
+  {
+    auto *p = static_cast<const char *> (ptr);
+    for (auto &b : blocks_)
+      if (p >= b.first && p + size <= b.first + b.second)
+	return true;
+    return false;
+  }
+
+private:
+  void *
+  do_allocate (size_t bytes, size_t align) override
+  {
+    void *p = std::pmr::new_delete_resource ()->allocate (bytes, align);
+    blocks_.emplace_back (static_cast<char *> (p), bytes);
+    return p;
+  }
+
+  void
+  do_deallocate (void *ptr, size_t bytes, size_t align) override
+  {
+    for (auto &b : blocks_)
+      if (b.first == ptr)
+	{
+	  b = blocks_.back ();
+	  blocks_.pop_back ();
+	  break;
+	}
+    std::pmr::new_delete_resource ()->deallocate (ptr, bytes, align);
+  }
+
+  bool
+  do_is_equal (const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  std::vector<std::pair<char *, size_t>> blocks_;
+};
+
+// aligning up from the last few bytes of a block can land past its end;
+// that must take a new block instead of returning memory outside it
+static void
+test_large_alignment_near_end ()
+{
+  tracking_resource upstream;
+  monotonic_arena arena (256, 256, &upstream);
+
+  for (size_t fill = 200; fill < 256; fill++)
+    {
+      arena.release ();
+      arena.allocate (fill, 1);
+
+      void *p = arena.allocate (1, 128);
+      assert (aligned (p, 128));
+      assert (upstream.contains (p, 1));
+    }
+}
+
+static void
+test_mark_and_reset ()
+{
+  monotonic_arena arena (128, 1024);
+
+  int *a = arena.create<int> (1);
+  auto m = arena.mark ();
+  size_t used = arena.used ();
+
+  for (int i = 0; i < 100; i++)
+    {
+      void *p = arena.allocate (24, 8);
+      assert (aligned (p, 8));
+      std::memset (p, 0, 24);
+    }
+
+  arena.reset (m);
+  assert (arena.used () == used);
+  assert (*a == 1);
+
+  arena.release ();
+  assert (arena.held () == 0);
+}
+
+static void
+test_resource ()
+{
+  monotonic_arena arena (64);
+  arena_resource resource (arena);
+
+  for (size_t align = 1; align <= 256; align *= 2)
+    {
+      void *p = resource.allocate (align * 3, align);
+      assert (aligned (p, align));
+      std::memset (p, 0, align * 3);
+    }
+}
+
+int
+main ()
+{
+  test_large_alignment_near_end ();
+  test_mark_and_reset ();
+  test_resource ();
+}
@@ -0,0 +1,132 @@
+#undef NDEBUG
+
+#include <new>
+#include <cassert>
+#include <limits>
+#include <cstdlib>
+#include <memory_resource>
+
+#include "lru_cache.h"
+#include "work_stealing_deque.h"
+#include "concurrent_blocking_queue.h"
+
+// global new is counted so a container that bypasses its resource and
+// falls back to std::allocator shows up as a stray allocation
+static size_t global_news;
+
+void *
+operator new (size_t size)
+{
+  global_news++;
+  if (void *p = std::malloc (size ? size : 1))
+    return p;
+  throw std::bad_alloc ();
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, size_t) noexcept
+{
+  std::free (p);
+}
+
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+  size_t allocations = 0;
+  size_t live = 0;
+
+private:
+  void *
+  do_allocate (size_t bytes, size_t align) override
+  {
+    allocations++;
+    live++;
+    return std::pmr::new_delete_resource ()->allocate (bytes, align);
+  }
+
+  void
+  do_deallocate (void *p, size_t bytes, size_t align) override
+  {
+    live--;
+    std::pmr::new_delete_resource ()->deallocate (p, bytes, align);
+  }
+
+  bool
+  do_is_equal (const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+// runs fill against a small monotonic buffer; every byte must come from
+// the buffer or its upstream, never from global new or the default
+template <typename F>
+static void
+check_routed (F fill)
+{
+  counting_resource upstream;
+  auto *old
+      = std::pmr::set_default_resource (std::pmr::null_memory_resource ());
+  {
+    std::pmr::monotonic_buffer_resource arena (64, &upstream);
+
+    size_t before = global_news;
+    fill (&arena);
+    assert (global_news == before);
+    assert (upstream.allocations > 0);
+  }
+  std::pmr::set_default_resource (old);
+  assert (upstream.live == 0);
+}
+
+static void
+test_lru_cache ()
+{
+  check_routed ([] (std::pmr::memory_resource *mr) {
+    pmr::lru_cache<int, int> cache (64, mr);
+    for (int i = 0; i < 1000; i++)
+      cache.put (i, i * 2);
+    assert (!cache.get (0));
+    assert (*cache.get (999) == 1998);
+  });
+}
+
+static void
+test_concurrent_blocking_queue ()
+{
+  check_routed ([] (std::pmr::memory_resource *mr) {
+    pmr::concurrent_blocking_queue<int> q (
+	std::numeric_limits<size_t>::max (), mr);
+    for (int i = 0; i < 1000; i++)
+      q.push (i);
+    for (int i = 0; i < 1000; i++)
+      assert (*q.try_pop () == i);
+  });
+}
+
+static void
+test_work_stealing_deque ()
+{
+  check_routed ([] (std::pmr::memory_resource *mr) {
+    pmr::work_stealing_deque<int> d (4, mr);
+    for (int i = 0; i < 1000; i++)
+      d.push (i);
+    int v;
+    for (int i = 999; i >= 0; i--)
+      assert (d.pop (v) && v == i);
+  });
+}
+
+int
+main ()
+{
+  test_lru_cache ();
+  test_concurrent_blocking_queue ();
+  test_work_stealing_deque ();
+}
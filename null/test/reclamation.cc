@@ -0,0 +1,178 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <thread>
+#include <cassert>
+
+#include "epoch_domain.h"
+#include "hazard_pointer.h"
+
+struct node
+{
+  explicit node (std::atomic<bool> &f) : freed (f) {}
+  ~node () { freed = true; }
+
+  std::atomic<bool> &freed;
+};
+
+// its deleter retires next into the same domain
+template <typename Domain>
+struct chain
+{
+  chain (Domain &d, node *n) : domain (d), next (n) {}
+  ~chain () { domain.retire (next); }
+
+  Domain &domain;
+  node *next;
+};
+
+template <typename Domain>
+static void
+reclaim_until (Domain &d, const std::atomic<bool> &freed)
+{
+  for (int i = 0; i < 8 && !freed; i++)
+    d.reclaim ();
+}
+
+// one thread at a time runs; the other spins on the step counter
+static void
+wait_step (const std::atomic<int> &step, int value)
+{
+  while (step.load () != value)
+    std::this_thread::yield ();
+}
+
+static void
+test_epoch_pinned_reader ()
+{
+  epoch_domain d (1);
+  std::atomic<bool> freed (false);
+  std::atomic<int> step (0);
+
+  std::thread reader ([&] {
+    auto g = d.pin ();
+    step = 1;
+    wait_step (step, 2);
+  });
+
+  wait_step (step, 1);
+  d.retire (new node (freed));
+  for (int i = 0; i < 8; i++)
+    d.reclaim ();
+  assert (!freed);
+
+  step = 2;
+  reader.join ();
+  reclaim_until (d, freed);
+  assert (freed);
+}
+
+static void
+test_epoch_thread_exit ()
+{
+  epoch_domain d;
+  std::atomic<bool> freed (false);
+
+  std::thread ([&] { d.retire (new node (freed)); }).join ();
+  assert (!freed);
+
+  reclaim_until (d, freed);
+  assert (freed);
+}
+
+static void
+test_epoch_retire_from_deleter ()
+{
+  std::atomic<bool> first (false), second (false);
+  {
+    epoch_domain d;
+    d.retire (new chain<epoch_domain> (d, new node (first)));
+    reclaim_until (d, first);
+    assert (first);
+  }
+
+  // the destructor must also drain what its own deleters retire
+  {
+    epoch_domain d;
+    d.retire (new chain<epoch_domain> (d, new node (second)));
+  }
+  assert (second);
+}
+
+static void
+test_hazard_protected ()
+{
+  hazard_domain d (1);
+  std::atomic<bool> freed (false);
+  std::atomic<node *> src (new node (freed));
+  std::atomic<int> step (0);
+
+  std::thread reader ([&] {
+    auto hp = d.make_hazard_pointer ();
+    node *p = hp.protect (src);
+    assert (p);
+    step = 1;
+    wait_step (step, 2);
+    assert (!p->freed);
+  });
+
+  wait_step (step, 1);
+  d.retire (src.exchange (nullptr));
+  d.reclaim ();
+  assert (!freed);
+
+  step = 2;
+  reader.join ();
+  d.reclaim ();
+  assert (freed);
+}
+
+// the exiting thread leaves a retired pointer that another thread still
+// protects; it is adopted but must wait for the protection to drop
+static void
+test_hazard_thread_exit ()
+{
+  hazard_domain d;
+  std::atomic<bool> freed (false);
+  std::atomic<node *> src (new node (freed));
+
+  auto hp = d.make_hazard_pointer ();
+  node *p = hp.protect (src);
+
+  std::thread ([&] { d.retire (src.exchange (nullptr)); }).join ();
+  d.reclaim ();
+  assert (!freed && p);
+
+  hp.reset_protection ();
+  d.reclaim ();
+  assert (freed);
+}
+
+static void
+test_hazard_retire_from_deleter ()
+{
+  std::atomic<bool> first (false), second (false);
+  {
+    hazard_domain d;
+    d.retire (new chain<hazard_domain> (d, new node (first)));
+    reclaim_until (d, first);
+    assert (first);
+  }
+
+  {
+    hazard_domain d;
+    d.retire (new chain<hazard_domain> (d, new node (second)));
+  }
+  assert (second);
+}
+
+int
+main ()
+{
+  test_epoch_pinned_reader ();
+  test_epoch_thread_exit ();
+  test_epoch_retire_from_deleter ();
+  test_hazard_protected ();
+  test_hazard_thread_exit ();
+  test_hazard_retire_from_deleter ();
+}
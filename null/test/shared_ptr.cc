@@ -0,0 +1,164 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+#include "weak_ptr.h"
+
+struct object
+{
+  static inline std::atomic<long> live{ 0 };
+
+  object () : check (0x5a5a) { live++; }
+  ~object ()
+  {
+    check = 0;
+    live--;
+  }
+
+  bool
+  valid () const
+  {
+    return check == 0x5a5a;
+  }
+
+  long check;
+};
+
+// the owner copies and drops on its biased count while other threads do
+// the same on the shared one; the owner's last release frees at once
+static void
+test_owner_and_shared_race ()
+{
+  constexpr int threads = 3;
+  constexpr long rounds = 100000;
+
+  auto p = make_shared<object> ();
+  std::atomic<bool> go (false);
+  std::vector<std::thread> others;
+  for (int i = 0; i < threads; i++)
+    others.emplace_back ([&] {
+      while (!go)
+	std::this_thread::yield ();
+      for (long r = 0; r < rounds; r++)
+	{
+	  shared_ptr<object> copy = p;
+	  assert (copy->valid ());
+	}
+    });
+
+  go = true;
+  for (long r = 0; r < rounds; r++)
+    {
+      shared_ptr<object> copy = p;
+      assert (copy->valid ());
+    }
+  for (auto &t : others)
+    t.join ();
+
+  assert (p.use_count () == 1);
+  p = nullptr;
+  assert (object::live == 0);
+}
+
+// copies handed to other threads take shared below zero; the object
+// waits for the owner to merge it
+static void
+test_hand_off ()
+{
+  constexpr int threads = 4;
+
+  auto p = make_shared<object> ();
+  std::vector<std::thread> others;
+  for (int i = 0; i < threads; i++)
+    others.emplace_back ([copy = p] () mutable {
+      assert (copy->valid ());
+      copy = nullptr;
+    });
+  p = nullptr;
+  for (auto &t : others)
+    t.join ();
+
+  assert (object::live == 1);
+  biased_refcount<>::drain ();
+  assert (object::live == 0);
+}
+
+// the owner exits with a block still queued and merges it on the way out
+static void
+test_owner_exit_drains ()
+{
+  std::promise<shared_ptr<object>> handed;
+  std::promise<void> dropped;
+  std::thread owner ([&] {
+    auto p = make_shared<object> ();
+    handed.set_value (p);
+    p = nullptr;
+    dropped.get_future ().wait ();
+  });
+
+  auto p = handed.get_future ().get ();
+  weak_ptr<object> w = p;
+  p = nullptr;
+  assert (object::live == 1);
+
+  dropped.set_value ();
+  owner.join ();
+  assert (object::live == 0);
+  assert (w.expired () && !w.lock ());
+}
+
+// once the owner is gone, the thread that drops the last reference merges
+static void
+test_owner_gone ()
+{
+  shared_ptr<object> kept;
+  std::thread ([&] { kept = make_shared<object> (); }).join ();
+
+  weak_ptr<object> w = kept;
+  shared_ptr<object> copy = w.lock ();
+  assert (copy && kept.use_count () == 2);
+  kept = nullptr;
+  assert (object::live == 1);
+  copy = nullptr;
+  assert (object::live == 0 && w.expired ());
+}
+
+// lock () reads both counts while the owner releases and merges
+static void
+test_weak_lock_race ()
+{
+  constexpr int threads = 3;
+
+  auto p = make_shared<object> ();
+  weak_ptr<object> w = p;
+  std::atomic<bool> released (false);
+  std::vector<std::thread> others;
+  for (int i = 0; i < threads; i++)
+    others.emplace_back ([&] {
+      while (!released)
+	if (auto q = w.lock ())
+	  assert (q->valid ());
+    });
+
+  std::this_thread::yield ();
+  p = nullptr;
+  released = true;
+  for (auto &t : others)
+    t.join ();
+
+  assert (object::live == 0 && w.expired () && !w.lock ());
+}
+
+int
+main ()
+{
+  test_owner_and_shared_race ();
+  test_hand_off ();
+  test_owner_exit_drains ();
+  test_owner_gone ();
+  test_weak_lock_race ();
+}
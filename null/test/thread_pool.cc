@@ -0,0 +1,72 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <stdexcept>
+
+#include "thread_pool.h"
+
+static void
+test_join_drains ()
+{
+  thread_pool pool (4);
+  std::atomic<int> done (0);
+
+  for (int i = 0; i < 1000; i++)
+    pool.post ([&] { done++; });
+  pool.join ();
+
+  assert (done == 1000);
+}
+
+// a throwing task neither kills its worker nor stops the rest
+static void
+test_task_exception ()
+{
+  thread_pool pool (2);
+  std::atomic<int> done (0);
+
+  pool.post ([] { throw std::runtime_error ("first"); });
+  for (int i = 0; i < 100; i++)
+    pool.post ([&] { done++; });
+
+  bool caught = false;
+  try
+    {
+      pool.join ();
+    }
+  catch (const std::runtime_error &e)
+    {
+      caught = std::string (e.what ()) == "first";
+    }
+
+  assert (caught);
+  assert (done == 100);
+}
+
+// tasks nested inside tasks go through the worker deques, tasks from
+// outside through the injection queue; both must drain
+static void
+test_nested_post ()
+{
+  thread_pool pool (3);
+  std::atomic<int> done (0);
+
+  for (int i = 0; i < 50; i++)
+    pool.post ([&] {
+      for (int j = 0; j < 20; j++)
+	pool.post ([&] { done++; });
+    });
+  pool.join ();
+
+  assert (done == 1000);
+}
+
+int
+main ()
+{
+  test_join_drains ();
+  test_task_exception ();
+  test_nested_post ();
+}
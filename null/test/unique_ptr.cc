@@ -0,0 +1,54 @@
+#undef NDEBUG
+
+#include <memory>
+#include <string>
+#include <cassert>
+
+#include "unique_ptr.h"
+
+struct named
+{
+  explicit named (std::string s) : name (std::move (s)) {}
+
+  std::string name;
+};
+
+// a std-typed argument pulls std::make_unique in through ADL; the call
+// must still resolve to exactly one function
+static void
+test_make_unique_std_argument ()
+{
+  auto p = make_unique<named> (std::string ("x"));
+  assert (p->name == "x");
+}
+
+static void
+test_arrays ()
+{
+  auto a = make_unique<int[]> (4);
+  for (int i = 0; i < 4; i++)
+    assert (a[i] == 0);
+
+  auto b = make_unique_for_overwrite<char[]> (16);
+  b[15] = 'x';
+  assert (b[15] == 'x');
+
+  unique_ptr<int[]> c (std::move (a));
+  assert (!a && c);
+}
+
+static void
+test_for_overwrite ()
+{
+  auto p = make_unique_for_overwrite<long> ();
+  *p = 7;
+  assert (*p == 7);
+}
+
+int
+main ()
+{
+  test_make_unique_std_argument ();
+  test_arrays ();
+  test_for_overwrite ();
+}
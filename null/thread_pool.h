@@ -0,0 +1,395 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <exception>
+#include <type_traits>
+#include <condition_variable>
+
+#include <boost/asio/execution_context.hpp>
+
+#include "work_stealing_deque.h"
+#include "concurrent_blocking_queue.h"
+
+// an asio execution_context, so asio::post and work guards can target
+// get_executor (); join () drains queued work, stop () abandons it. A
+// task that throws does not take its worker down: the first exception is
+// rethrown by join () and later ones are dropped.
+class thread_pool : public boost::asio::execution_context
+{
+  struct task
+  {
+    virtual ~task () = default;
+    virtual void run () = 0;
+  };
+
+  template <typename F>
+  struct task_impl : public task
+  {
+    explicit task_impl (F f_) : f (std::move (f_)) {}
+
+    void
+    run () override
+    {
+      f ();
+    }
+
+    F f;
+  };
+
+  struct worker
+  {
+    thread_pool *pool;
+    work_stealing_deque<task *> deque;
+    std::thread thread;
+  };
+
+public:
+  class executor_type;
+
+  explicit thread_pool (size_t threads = std::thread::hardware_concurrency ())
+      : stopped_ (false), injected_ (0), sleepers_ (0), outstanding_ (0)
+  {
+    if (threads == 0)
+      threads = 1;
+
+    for (size_t i = 0; i < threads; i++)
+      workers_.push_back (std::make_unique<worker> ());
+
+    try
+      {
+	for (size_t i = 0; i < threads; i++)
+	  {
+	    workers_[i]->pool = this;
+	    workers_[i]->thread = std::thread ([this, i] { run (i); });
+	  }
+      }
+    catch (...)
+      {
+	stop ();
+	join_threads ();
+	throw;
+      }
+  }
+
+  ~thread_pool ()
+  {
+    stop ();
+    join_threads ();
+    shutdown ();
+
+    task *t;
+    for (auto &w : workers_)
+      while (w->deque.pop (t))
+	delete t;
+    while (auto elem = global_.try_pop ())
+      delete *elem;
+  }
+
+  thread_pool (const thread_pool &) = delete;
+  thread_pool &operator= (const thread_pool &) = delete;
+
+  template <typename F>
+  void
+  post (F &&f)
+  {
+    outstanding_.fetch_add (1, std::memory_order_relaxed);
+    using task_type = task_impl<typename std::decay<F>::type>;
+    task *t = new task_type (std::forward<F> (f));
+
+    worker *w = current_;
+    if (w && w->pool == this)
+      w->deque.push (t);
+    else
+      {
+	injected_.fetch_add (1, std::memory_order_relaxed);
+	global_.push (t);
+      }
+
+    wake ();
+  }
+
+  // workers finish the task in hand and exit; tasks still queued are
+  // never run and are destroyed with the pool
+  void
+  stop ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      stopped_.store (true, std::memory_order_relaxed);
+    }
+    idle_cv_.notify_all ();
+    done_cv_.notify_all ();
+  }
+
+  // runs everything posted so far, then stops; rethrows the first
+  // exception a task threw
+  void
+  join ()
+  {
+    {
+      std::unique_lock<std::mutex> lock (mutex_);
+      done_cv_.wait (lock, [this] {
+	return outstanding_.load (std::memory_order_acquire) == 0
+	       || stopped_.load (std::memory_order_relaxed);
+      });
+    }
+    stop ();
+    join_threads ();
+
+    if (auto error = std::exchange (error_, nullptr))
+      std::rethrow_exception (error);
+  }
+
+  size_t
+  size () const
+  {
+    return workers_.size ();
+  }
+
+  executor_type get_executor () noexcept;
+
+private:
+  void
+  run (size_t index)
+  {
+    worker &self = *workers_[index];
+    current_ = &self;
+    std::uint32_t seed = static_cast<std::uint32_t> (index) * 2654435761u + 1;
+
+    while (!stopped_.load (std::memory_order_relaxed))
+      {
+	task *t = nullptr;
+	if (self.deque.pop (t) || take_global (t) || steal (index, seed, t))
+	  {
+	    try
+	      {
+		t->run ();
+	      }
+	    catch (...)
+	      {
+		std::lock_guard<std::mutex> lock (mutex_);
+		if (!error_)
+		  error_ = std::current_exception ();
+	      }
+	    delete t;
+	    work_finished ();
+	    continue;
+	  }
+
+	park ();
+      }
+
+    current_ = nullptr;
+  }
+
+  // injected_ is bumped before each push, so a zero means there is
+  // nothing to take and idle workers never touch the queue's mutex
+  bool
+  take_global (task *&t)
+  {
+    if (injected_.load (std::memory_order_relaxed) == 0)
+      return false;
+
+    auto elem = global_.try_pop ();
+    if (!elem)
+      return false;
+
+    injected_.fetch_sub (1, std::memory_order_relaxed);
+    t = *elem;
+    return true;
+  }
+
+  bool
+  steal (size_t index, std::uint32_t &seed, task *&t)
+  {
+    size_t n = workers_.size ();
+    if (n < 2)
+      return false;
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    size_t victim = seed % n;
+    for (size_t i = 0; i < n; i++, victim = (victim + 1) % n)
+      if (victim != index && workers_[victim]->deque.steal (t))
+	return true;
+
+    return false;
+  }
+
+  bool
+  has_work () const
+  {
+    if (injected_.load (std::memory_order_relaxed) != 0)
+      return true;
+
+    for (auto &w : workers_)
+      if (!w->deque.empty ())
+	return true;
+
+    return false;
+  }
+
+  void
+  park ()
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    sleepers_.fetch_add (1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+
+    if (!has_work () && !stopped_.load (std::memory_order_relaxed))
+      idle_cv_.wait (lock);
+
+    sleepers_.fetch_sub (1, std::memory_order_relaxed);
+  }
+
+  void
+  wake ()
+  {
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+    if (sleepers_.load (std::memory_order_relaxed) == 0)
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+    }
+    idle_cv_.notify_one ();
+  }
+
+  void
+  work_started () noexcept
+  {
+    outstanding_.fetch_add (1, std::memory_order_relaxed);
+  }
+
+  void
+  work_finished () noexcept
+  {
+    if (outstanding_.fetch_sub (1, std::memory_order_acq_rel) != 1)
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+    }
+    done_cv_.notify_all ();
+  }
+
+  bool
+  running_in_this_thread () const noexcept
+  {
+    return current_ && current_->pool == this;
+  }
+
+  void
+  join_threads ()
+  {
+    for (auto &w : workers_)
+      if (w->thread.joinable ())
+	w->thread.join ();
+  }
+
+private:
+  std::vector<std::unique_ptr<worker>> workers_;
+  concurrent_blocking_queue<task *> global_;
+
+  std::mutex mutex_;
+  std::atomic<bool> stopped_;
+  std::atomic<size_t> injected_;
+  std::atomic<size_t> sleepers_;
+  std::atomic<size_t> outstanding_;
+  std::condition_variable idle_cv_;
+  std::condition_variable done_cv_;
+  std::exception_ptr error_;
+
+  static inline thread_local worker *current_ = nullptr;
+};
+
+class thread_pool::executor_type
+{
+  friend class thread_pool;
+
+public:
+  boost::asio::execution_context &
+  context () const noexcept
+  {
+    return *pool_;
+  }
+
+  void
+  on_work_started () const noexcept
+  {
+    pool_->work_started ();
+  }
+
+  void
+  on_work_finished () const noexcept
+  {
+    pool_->work_finished ();
+  }
+
+  template <typename F, typename Alloc>
+  void
+  dispatch (F &&f, const Alloc &) const
+  {
+    if (pool_->running_in_this_thread ())
+      {
+	typename std::decay<F>::type tmp (std::forward<F> (f));
+	tmp ();
+      }
+    else
+      pool_->post (std::forward<F> (f));
+  }
+
+  template <typename F, typename Alloc>
+  void
+  post (F &&f, const Alloc &) const
+  {
+    pool_->post (std::forward<F> (f));
+  }
+
+  template <typename F, typename Alloc>
+  void
+  defer (F &&f, const Alloc &) const
+  {
+    pool_->post (std::forward<F> (f));
+  }
+
+  bool
+  running_in_this_thread () const noexcept
+  {
+    return pool_->running_in_this_thread ();
+  }
+
+  friend bool
+  operator== (const executor_type &a, const executor_type &b) noexcept
+  {
+    return a.pool_ == b.pool_;
+  }
+
+  friend bool
+  operator!= (const executor_type &a, const executor_type &b) noexcept
+  {
+    return a.pool_ != b.pool_;
+  }
+
+private:
+  explicit executor_type (thread_pool &pool) noexcept : pool_ (&pool) {}
+
+  thread_pool *pool_;
+};
+
+inline thread_pool::executor_type
+thread_pool::get_executor () noexcept
+{
+  return executor_type (*this);
+}
+
+#endif // THREAD_POOL_H
@@ -26,6 +26,28 @@ public:
   }
 };
 
+template <typename T>
+class default_delete<T[]>
+{
+public:
+  static_assert (sizeof (T) > 0, "Cannot delete an incomplete type.");
+
+  default_delete () noexcept = default;
+
+  template <typename Y,
+	    typename = typename std::enable_if<
+		std::is_convertible<Y (*)[], T (*)[]>::value>::type>
+  default_delete (const default_delete<Y[]> &) noexcept
+  {
+  }
+
+  void
+  operator() (T *ptr) const
+  {
+    delete[] ptr;
+  }
+};
+
 template <typename T, typename Deleter,
 	  typename
 	  = decltype (std::declval<Deleter> () (static_cast<T *> (0)))>
@@ -208,4 +230,126 @@ private:
   pointer ptr_;
 };
 
+// arrays convert only between identical element types, so a derived
+// array is never deleted through a base pointer
+template <typename T, typename Deleter>
+class unique_ptr<T[], Deleter> : private unique_ptr_base<T, Deleter>
+{
+  using base_type = unique_ptr_base<T, Deleter>;
+
+public:
+  using pointer = T *;
+  using element_type = T;
+  using deleter_type = Deleter;
+
+  unique_ptr () noexcept : base_type (), ptr_ () {}
+  unique_ptr (std::nullptr_t) noexcept : base_type (), ptr_ () {}
+
+  explicit unique_ptr (pointer ptr) : base_type (), ptr_ (ptr) {}
+  unique_ptr (pointer ptr, deleter_type del)
+      : base_type (std::move (del)), ptr_ (ptr)
+  {
+  }
+
+  ~unique_ptr ()
+  {
+    if (ptr_)
+      static_cast<base_type &> (*this) (ptr_);
+  }
+
+  unique_ptr (const unique_ptr &) = delete;
+  unique_ptr &operator= (const unique_ptr &) = delete;
+
+  unique_ptr (unique_ptr &&other) noexcept
+      : base_type (std::move (other)), ptr_ (std::exchange (other.ptr_, {}))
+  {
+  }
+
+  unique_ptr &
+  operator= (unique_ptr &&other) noexcept
+  {
+    unique_ptr (std::move (other)).swap (*this);
+    return *this;
+  }
+
+  void
+  swap (unique_ptr &other) noexcept
+  {
+    using std::swap;
+    swap (static_cast<base_type &> (*this), static_cast<base_type &> (other));
+    swap (ptr_, other.ptr_);
+  }
+
+  element_type &
+  operator[] (size_t i) const
+  {
+    return ptr_[i];
+  }
+
+  explicit
+  operator bool () const noexcept
+  {
+    return ptr_;
+  }
+
+  pointer
+  get () const noexcept
+  {
+    return ptr_;
+  }
+
+  void
+  reset (pointer ptr = {}) noexcept
+  {
+    unique_ptr (ptr).swap (*this);
+  }
+
+  pointer
+  release () noexcept
+  {
+    return std::exchange (ptr_, {});
+  }
+
+  deleter_type &
+  get_deleter () noexcept
+  {
+    return static_cast<deleter_type &> (*this);
+  }
+
+  const deleter_type &
+  get_deleter () const noexcept
+  {
+    return static_cast<const deleter_type &> (*this);
+  }
+
+private:
+  pointer ptr_;
+};
+
+// value-initialized, so scalar elements start zeroed
+template <typename T>
+typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0,
+			unique_ptr<T>>::type
+make_unique (size_t n)
+{
+  return unique_ptr<T> (new typename std::remove_extent<T>::type[n] ());
+}
+
+// default-initialized: scalars are left indeterminate, for storage that
+// is about to be overwritten anyway
+template <typename T>
+typename std::enable_if<!std::is_array<T>::value, unique_ptr<T>>::type
+make_unique_for_overwrite ()
+{
+  return unique_ptr<T> (new T);
+}
+
+template <typename T>
+typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0,
+			unique_ptr<T>>::type
+make_unique_for_overwrite (size_t n)
+{
+  return unique_ptr<T> (new typename std::remove_extent<T>::type[n]);
+}
+
 #endif // UNIQUE_PTR_H
@@ -3,22 +3,26 @@
 
 #include "shared_ptr.h"
 
-template <typename T>
+template <typename T, typename Policy>
 class weak_ptr
 {
-  template <typename U>
+  template <typename U, typename P>
   friend class weak_ptr;
 
-  template <typename U>
+  template <typename U, typename P>
   friend class shared_ptr;
 
+  using block_type = control_block_base<Policy>;
+
 public:
   using element_type = T;
+  using policy_type = Policy;
 
   weak_ptr (std::nullptr_t = nullptr) : ptr_ (nullptr), cb_ (nullptr) {}
 
   template <typename U>
-  weak_ptr (const shared_ptr<U> &sp) noexcept : ptr_ (sp.ptr_), cb_ (sp.cb_)
+  weak_ptr (const shared_ptr<U, Policy> &sp) noexcept
+      : ptr_ (sp.ptr_), cb_ (sp.cb_)
   {
     static_assert (std::is_convertible<U *, T *>::value,
 		   "U* must be convertible to T*");
@@ -47,7 +51,7 @@ public:
   }
 
   template <typename U>
-  weak_ptr (const weak_ptr<U> &other) noexcept
+  weak_ptr (const weak_ptr<U, Policy> &other) noexcept
       : ptr_ (other.ptr_), cb_ (other.cb_)
   {
     static_assert (std::is_convertible<U *, T *>::value,
@@ -58,7 +62,7 @@ public:
 
   template <typename U>
   weak_ptr &
-  operator= (const weak_ptr<U> &other) noexcept
+  operator= (const weak_ptr<U, Policy> &other) noexcept
   {
     weak_ptr (other).swap (*this);
     return *this;
@@ -66,7 +70,7 @@ public:
 
   template <typename U>
   weak_ptr &
-  operator= (const shared_ptr<U> &sp) noexcept
+  operator= (const shared_ptr<U, Policy> &sp) noexcept
   {
     weak_ptr (sp).swap (*this);
     return *this;
@@ -86,7 +90,7 @@ public:
   }
 
   template <typename U>
-  weak_ptr (weak_ptr<U> &&other) noexcept
+  weak_ptr (weak_ptr<U, Policy> &&other) noexcept
       : ptr_ (std::exchange (other.ptr_, nullptr)),
 	cb_ (std::exchange (other.cb_, nullptr))
   {
@@ -96,7 +100,7 @@ public:
 
   template <typename U>
   weak_ptr &
-  operator= (weak_ptr<U> &&other) noexcept
+  operator= (weak_ptr<U, Policy> &&other) noexcept
   {
     static_assert (std::is_convertible<U *, T *>::value,
 		   "U* must be convertible to T*");
@@ -112,12 +116,12 @@ public:
     swap (cb_, other.cb_);
   }
 
-  shared_ptr<T>
+  shared_ptr<T, Policy>
   lock () noexcept
   {
     if (cb_ && cb_->lock_use_count ())
       {
-	shared_ptr<T> sp;
+	shared_ptr<T, Policy> sp;
 	sp.ptr_ = ptr_;
 	sp.cb_ = cb_;
 	return sp;
@@ -140,12 +144,12 @@ public:
   long
   use_count () const noexcept
   {
-    return cb_ ? cb_->use_count.load (std::memory_order_relaxed) : 0;
+    return cb_ ? cb_->use_count () : 0;
   }
 
 private:
   T *ptr_;
-  control_block_base *cb_;
+  block_type *cb_;
 };
 
 #endif // WEAK_PTR_H
@@ -0,0 +1,221 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <memory_resource>
+
+template <typename T, typename Alloc = std::allocator<T>>
+class work_stealing_deque
+{
+  static_assert (std::is_trivially_copyable<T>::value,
+		 "T must be trivially copyable");
+
+  struct array
+  {
+    array (size_t n, std::atomic<T> *s) : capacity (n), slots (s) {}
+
+    size_t capacity;
+    std::atomic<T> *slots;
+
+    std::atomic<T> &
+    at (std::int64_t i)
+    {
+      return slots[static_cast<size_t> (i) & (capacity - 1)];
+    }
+  };
+
+  template <typename U>
+  using rebind =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<U>;
+  using array_traits = std::allocator_traits<rebind<array>>;
+  using slot_traits = std::allocator_traits<rebind<std::atomic<T>>>;
+
+public:
+  using size_type = size_t;
+  using allocator_type = Alloc;
+
+  explicit work_stealing_deque (size_type capacity = 64,
+				const Alloc &alloc = Alloc ())
+      : top_ (0), bottom_ (0), array_alloc_ (alloc), slot_alloc_ (alloc),
+	arrays_ (rebind<array *> (alloc))
+  {
+    size_type pow2 = 2;
+    while (pow2 < capacity)
+      pow2 *= 2;
+
+    array *a = make_array (pow2);
+    try
+      {
+	arrays_.push_back (a);
+      }
+    catch (...)
+      {
+	free_array (a);
+	throw;
+      }
+    array_.store (a, std::memory_order_relaxed);
+  }
+
+  ~work_stealing_deque ()
+  {
+    for (array *a : arrays_)
+      free_array (a);
+  }
+
+  work_stealing_deque (const work_stealing_deque &) = delete;
+  work_stealing_deque &operator= (const work_stealing_deque &) = delete;
+
+  // owner only
+  void
+  push (T item)
+  {
+    std::int64_t b = bottom_.load (std::memory_order_relaxed);
+    std::int64_t t = top_.load (std::memory_order_acquire);
+    array *a = array_.load (std::memory_order_relaxed);
+
+    if (b - t > static_cast<std::int64_t> (a->capacity) - 1)
+      a = grow (a, t, b);
+
+    a->at (b).store (item, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+    bottom_.store (b + 1, std::memory_order_relaxed);
+  }
+
+  // owner only
+  bool
+  pop (T &item)
+  {
+    std::int64_t b = bottom_.load (std::memory_order_relaxed) - 1;
+    array *a = array_.load (std::memory_order_relaxed);
+    bottom_.store (b, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+    std::int64_t t = top_.load (std::memory_order_relaxed);
+
+    if (t > b)
+      {
+	bottom_.store (b + 1, std::memory_order_relaxed);
+	return false;
+      }
+
+    item = a->at (b).load (std::memory_order_relaxed);
+    if (t == b)
+      {
+	bool won = top_.compare_exchange_strong (
+	    t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	bottom_.store (b + 1, std::memory_order_relaxed);
+	return won;
+      }
+
+    return true;
+  }
+
+  bool
+  steal (T &item)
+  {
+    std::int64_t t = top_.load (std::memory_order_acquire);
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+    std::int64_t b = bottom_.load (std::memory_order_acquire);
+
+    if (t >= b)
+      return false;
+
+    array *a = array_.load (std::memory_order_acquire);
+    item = a->at (t).load (std::memory_order_relaxed);
+
+    return top_.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst,
+					 std::memory_order_relaxed);
+  }
+
+  size_type
+  size () const
+  {
+    std::int64_t b = bottom_.load (std::memory_order_relaxed);
+    std::int64_t t = top_.load (std::memory_order_relaxed);
+    return b > t ? static_cast<size_type> (b - t) : 0;
+  }
+
+  bool
+  empty () const
+  {
+    return size () == 0;
+  }
+
+private:
+  array *
+  grow (array *a, std::int64_t t, std::int64_t b)
+  {
+    array *bigger = make_array (a->capacity * 2);
+    for (std::int64_t i = t; i < b; i++)
+      bigger->at (i).store (a->at (i).load (std::memory_order_relaxed),
+			    std::memory_order_relaxed);
+
+    // thieves may still read the old array, so it lives until destruction
+    try
+      {
+	arrays_.push_back (bigger);
+      }
+    catch (...)
+      {
+	free_array (bigger);
+	throw;
+      }
+    array_.store (bigger, std::memory_order_release);
+
+    return bigger;
+  }
+
+  array *
+  make_array (size_t capacity)
+  {
+    std::atomic<T> *slots = slot_traits::allocate (slot_alloc_, capacity);
+    for (size_t i = 0; i < capacity; i++)
+      slot_traits::construct (slot_alloc_, slots + i);
+
+    array *a;
+    try
+      {
+	a = array_traits::allocate (array_alloc_, 1);
+      }
+    catch (...)
+      {
+	slot_traits::deallocate (slot_alloc_, slots, capacity);
+	throw;
+      }
+
+    array_traits::construct (array_alloc_, a, capacity, slots);
+    return a;
+  }
+
+  void
+  free_array (array *a) noexcept
+  {
+    for (size_t i = 0; i < a->capacity; i++)
+      slot_traits::destroy (slot_alloc_, a->slots + i);
+    slot_traits::deallocate (slot_alloc_, a->slots, a->capacity);
+
+    array_traits::destroy (array_alloc_, a);
+    array_traits::deallocate (array_alloc_, a, 1);
+  }
+
+private:
+  std::atomic<std::int64_t> top_;
+  unsigned char pad_[64 - sizeof (top_)];
+  std::atomic<std::int64_t> bottom_;
+  std::atomic<array *> array_;
+  rebind<array> array_alloc_;
+  rebind<std::atomic<T>> slot_alloc_;
+  std::vector<array *, rebind<array *>> arrays_;
+};
+
+namespace pmr
+{
+template <typename T>
+using work_stealing_deque
+    = ::work_stealing_deque<T, std::pmr::polymorphic_allocator<T>>;
+}
+
+#endif // WORK_STEALING_DEQUE_H